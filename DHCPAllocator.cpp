@@ -0,0 +1,131 @@
+#include "DHCPAllocator.h"
+#include <algorithm>
+
+using namespace DHCPLite;
+
+std::vector<std::pair<DWORD, DWORD>> DHCPLite::SubtractRanges(std::vector<std::pair<DWORD, DWORD>> ranges, std::vector<std::pair<DWORD, DWORD>> exclusions) {
+	std::sort(ranges.begin(), ranges.end());
+	std::sort(exclusions.begin(), exclusions.end());
+
+	std::vector<std::pair<DWORD, DWORD>> result;
+	auto itExclusion = exclusions.begin();
+	for (auto range : ranges) {
+		// Exclusions ending before this range can not affect it or any later range
+		while ((exclusions.end() != itExclusion) && (itExclusion->second < range.first)) {
+			++itExclusion;
+		}
+		bool bRemaining = true;
+		for (auto it = itExclusion; bRemaining && (exclusions.end() != it) && (it->first <= range.second); ++it) {
+			if (range.first < it->first) {
+				result.emplace_back(range.first, it->first - 1);
+			}
+			if (it->second >= range.second) {
+				bRemaining = false;
+			}
+			else {
+				range.first = max(range.first, it->second + 1);
+			}
+		}
+		if (bRemaining) {
+			result.push_back(range);
+		}
+	}
+
+	// Merge overlapping or adjacent ranges
+	std::vector<std::pair<DWORD, DWORD>> merged;
+	for (auto &&range : result) {
+		if (!merged.empty() && (static_cast<ULONGLONG>(merged.back().second) + 1 >= range.first)) {
+			merged.back().second = max(merged.back().second, range.second);
+		}
+		else {
+			merged.push_back(range);
+		}
+	}
+	return merged;
+}
+
+const SubnetRuntime *DHCPLite::FindSubnet(const RuntimeConfig &runtimeConfig, DWORD dwAddrValue) {
+	// Subnets do not overlap, so only the last one starting at or below the address can contain it
+	auto it = std::upper_bound(runtimeConfig.vSubnets.begin(), runtimeConfig.vSubnets.end(), dwAddrValue, [](DWORD value, const SubnetRuntime &subnet) {
+		return value < subnet.dwNetworkValue;
+		});
+	if (runtimeConfig.vSubnets.begin() == it) return nullptr;
+	--it;
+	return ((dwAddrValue & it->dwMaskValue) == it->dwNetworkValue) ? &*it : nullptr;
+}
+
+AddressAllocator::AddressAllocator(LeaseTable<DWORD> &leaseTable) : leaseTable(leaseTable) {
+}
+
+DWORD AddressAllocator::AllocateAddress(const RuntimeConfig &runtimeConfig, const SubnetRuntime &subnet, const BYTE *pbHardwareAddr, BYTE bHardwareAddrSize, bool bReservationOnly, bool &bReserved) {
+	// Reservation for this hardware address; reservations are global, so only one on the client's link applies
+	auto itReservation = runtimeConfig.mapReservations.find(std::string(pbHardwareAddr, pbHardwareAddr + min(bHardwareAddrSize, static_cast<BYTE>(16))));
+	bReserved = (runtimeConfig.mapReservations.end() != itReservation)
+		&& ((itReservation->second & subnet.dwMaskValue) == subnet.dwNetworkValue)
+		&& (INVALID_LEASE_HANDLE == leaseTable.FindByAddress(itReservation->second));
+	if (bReserved) {
+		return itReservation->second;
+	}
+
+	if (subnet.vRanges.empty() || bReservationOnly) return 0;
+
+	// Continue after the last address offered on this subnet, wrapping to offer the lowest address first
+	auto itCursor = mapNextOfferAddrValue.find(subnet.dwNetworkValue);
+	DWORD dwOfferAddrValue = (mapNextOfferAddrValue.end() != itCursor) ? itCursor->second : subnet.vRanges.front().first;
+	size_t stRange = std::upper_bound(subnet.vRanges.begin(), subnet.vRanges.end(), std::make_pair(dwOfferAddrValue, ~DWORD{ 0 })) - subnet.vRanges.begin();
+	if ((0 == stRange) || (subnet.vRanges[stRange - 1].second < dwOfferAddrValue)) {
+		// Cursor fell outside the ranges (e.g. after a reload) - start at the next range
+		stRange = stRange % subnet.vRanges.size();
+		dwOfferAddrValue = subnet.vRanges[stRange].first;
+	}
+	else {
+		stRange--;
+	}
+
+	for (ULONGLONG ullRemaining = subnet.ullRangeSize; 0 != ullRemaining; ullRemaining--) {  // Detect address exhaustion
+		const bool bAvailable = (INVALID_LEASE_HANDLE == leaseTable.FindByAddress(dwOfferAddrValue));
+		const DWORD dwCandidateValue = dwOfferAddrValue;
+		if (dwOfferAddrValue == subnet.vRanges[stRange].second) {
+			stRange = (stRange + 1) % subnet.vRanges.size();
+			dwOfferAddrValue = subnet.vRanges[stRange].first;
+		}
+		else {
+			dwOfferAddrValue++;
+		}
+		if (bAvailable) {
+			mapNextOfferAddrValue[subnet.dwNetworkValue] = dwOfferAddrValue;
+			return dwCandidateValue;
+		}
+	}
+	return 0;
+}
+
+AddressAllocator::LeaseHandle AddressAllocator::AllocateLease(const RuntimeConfig &runtimeConfig, const SubnetRuntime &subnet, const BYTE *pbHardwareAddr, BYTE bHardwareAddrSize,
+	const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize, ULONGLONG ullNow) {
+	auto isInRanges = [&subnet](DWORD dwAddrValue) {
+		auto it = std::upper_bound(subnet.vRanges.begin(), subnet.vRanges.end(), std::make_pair(dwAddrValue, ~DWORD{ 0 }));
+		return (subnet.vRanges.begin() != it) && (dwAddrValue <= (--it)->second);
+	};
+	// A reload that changed the ranges can leave the pool holding bindings for addresses outside them. Taking
+	// those out once means a pool whose size reaches its range size has no free address left to scan for.
+	auto itGeneration = mapPoolRangesGeneration.emplace(subnet.dwNetworkValue, subnet.ullRangesGeneration).first;
+	if (itGeneration->second != subnet.ullRangesGeneration) {
+		leaseTable.Prune(subnet.dwNetworkValue, isInRanges);
+		itGeneration->second = subnet.ullRangesGeneration;
+	}
+
+	// With a binding for every address in the pool there is nothing to scan for
+	const bool bPoolFull = (leaseTable.GetPoolSize(subnet.dwNetworkValue) >= subnet.ullRangeSize);
+	bool bReserved;
+	const DWORD dwAddrValue = AllocateAddress(runtimeConfig, subnet, pbHardwareAddr, bHardwareAddrSize, bPoolFull, bReserved);
+	if (0 != dwAddrValue) {
+		// Reserved addresses are never reclaimed, so they stay out of the subnet's pool
+		const LeaseHandle lhLease = leaseTable.Add(dwAddrValue, pbClientIdentifier, dwClientIdentifierSize,
+			true, bReserved ? LeaseTable<DWORD>::NO_POOL : subnet.dwNetworkValue);
+		leaseTable.Touch(lhLease, ullNow);
+		return lhLease;
+	}
+
+	// Pool exhausted - take over its least recently seen binding if that client is gone
+	return leaseTable.Reclaim(subnet.dwNetworkValue, ullNow, subnet.dwIdleReclaimTime, pbClientIdentifier, dwClientIdentifierSize, isInRanges);
+}
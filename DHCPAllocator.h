@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DHCPPlatform.h"
+#include "DHCPLeaseTable.h"
+
+namespace DHCPLite {
+	// Immutable form of a subnet, compiled from DHCPServer::SubnetConfig; address values are host order
+	struct SubnetRuntime {
+		DWORD dwNetworkValue;
+		DWORD dwMaskValue;
+		DWORD dwLeaseTime; // Network order
+		DWORD dwIdleReclaimTime; // Seconds, 0 to reclaim expired bindings only
+		std::vector<std::pair<DWORD, DWORD>> vRanges; // Allocatable address values, sorted, exclusions removed
+		ULONGLONG ullRangeSize; // Addresses in vRanges
+		ULONGLONG ullRangesGeneration; // RuntimeConfig generation that last changed vRanges
+		std::vector<std::pair<BYTE, std::vector<BYTE>>> vOptions;
+		std::vector<BYTE> vInformReplyTemplate; // Pre-encoded DHCPACK reply to DHCPINFORM
+	};
+
+	// Everything request processing needs from the configuration; replaced as a whole on reload
+	struct RuntimeConfig {
+		std::vector<SubnetRuntime> vSubnets; // Sorted by network value
+		std::unordered_map<std::string, DWORD> mapReservations; // Hardware address -> address value
+		ULONGLONG ullGeneration = 0; // One more than the configuration it replaced
+	};
+
+	// Remove every excluded range from ranges; both are inclusive address value ranges. The result is sorted and merged.
+	std::vector<std::pair<DWORD, DWORD>> SubtractRanges(std::vector<std::pair<DWORD, DWORD>> ranges, std::vector<std::pair<DWORD, DWORD>> exclusions);
+
+	// Subnet containing an address value, nullptr if none does
+	const SubnetRuntime *FindSubnet(const RuntimeConfig &runtimeConfig, DWORD dwAddrValue);
+
+	// Picks addresses for new DHCPv4 clients and adds their leases to a lease table keyed by address value.
+	// Each subnet is its own lease table pool, keyed by its network value. Not thread safe - like the lease
+	// table, it is used from the request processing thread only.
+	class AddressAllocator {
+	public:
+		typedef LeaseTable<DWORD>::LeaseHandle LeaseHandle;
+		static constexpr LeaseHandle INVALID_LEASE_HANDLE = LeaseTable<DWORD>::INVALID_LEASE_HANDLE;
+
+		explicit AddressAllocator(LeaseTable<DWORD> &leaseTable);
+
+		// bReserved is set if the address comes from a reservation; bReservationOnly skips the subnet's ranges
+		// Returns 0 if no address is available
+		DWORD AllocateAddress(const RuntimeConfig &runtimeConfig, const SubnetRuntime &subnet, const BYTE *pbHardwareAddr, BYTE bHardwareAddrSize,
+			bool bReservationOnly, bool &bReserved);
+
+		// Add a lease for a new client at time ullNow, reclaiming a stale binding if the subnet's pool is exhausted.
+		// The first call after a reload changed the subnet's ranges takes bindings outside them out of its pool.
+		// Returns INVALID_LEASE_HANDLE if no address is available
+		LeaseHandle AllocateLease(const RuntimeConfig &runtimeConfig, const SubnetRuntime &subnet, const BYTE *pbHardwareAddr, BYTE bHardwareAddrSize,
+			const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize, ULONGLONG ullNow);
+
+	private:
+		LeaseTable<DWORD> &leaseTable;
+		std::unordered_map<DWORD, DWORD> mapNextOfferAddrValue; // Allocation cursor, keyed by subnet network value
+		std::unordered_map<DWORD, ULONGLONG> mapPoolRangesGeneration; // Ranges each pool holds bindings for, keyed by subnet network value
+	};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+namespace DHCPLite {
+	class DHCPException : public std::exception {
+	public:
+		DHCPException(const char *Message) : message(Message) {}
+		const char *what() const noexcept override { return message; }
+
+	private:
+		const char *message;
+	};
+
+	class MessageException : public DHCPException {
+	public:
+		MessageException(const char *Message) : DHCPException(Message) {}
+	};
+
+	class IPAddrException : public DHCPException {
+	public:
+		IPAddrException(const char *Message) : DHCPException(Message) {}
+	};
+
+	class SocketException : public DHCPException {
+	public:
+		SocketException(const char *Message) : DHCPException(Message) {}
+	};
+
+	class RequestException : public DHCPException {
+	public:
+		RequestException(const char *Message) : DHCPException(Message) {}
+	};
+
+	class ConfigException : public DHCPException {
+	private:
+		std::string message;
+
+	public:
+		ConfigException(const std::string &Message) : DHCPException(""), message(Message) {}
+		const char *what() const noexcept override { return message.c_str(); }
+	};
+}
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <cstring>
+#include <cassert>
+#include "DHCPPlatform.h"
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DHCPLITE_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace DHCPLite {
+	// Expiry time of leases that have not been acknowledged yet
+	constexpr ULONGLONG LEASE_NEVER_EXPIRES = ~0ULL;
+	// Longest client identifier a lease can hold (DHCP option length, RFC 2132 section 9.14)
+	constexpr auto MAX_CLIENT_IDENTIFIER_LENGTH = 255;
+	// Offered but unacknowledged leases may be reclaimed once the client has been silent this long
+	constexpr auto LEASE_OFFER_HOLD_SECONDS = 2 * 60;
+
+	// FNV-1a (64-bit) over a client identifier, DUID or circuit-id
+	inline ULONGLONG HashClientIdentifier(const BYTE *pbData, size_t size) {
+		ULONGLONG ullHash = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < size; i++) {
+			ullHash ^= pbData[i];
+			ullHash *= 0x100000001b3ULL;
+		}
+		return ullHash;
+	}
+
+	// Open-addressing index from a hash to lease handles. Slots are probed in groups of 16 whose 1-byte
+	// tags (7 bits of the hash) are compared with one SSE2 instruction, so a lookup usually reads one
+	// tag group and one slot; an entry costs about 6 bytes instead of a heap node and a bucket pointer.
+	class LeaseIndex {
+	public:
+		static constexpr DWORD INVALID_SLOT = static_cast<DWORD>(-1);
+
+		// Handle for which match(handle) is true, or INVALID_SLOT
+		template <class Match>
+		DWORD Find(ULONGLONG ullHash, Match match) const {
+			if (vTags.empty()) {
+				return INVALID_SLOT;
+			}
+			ullHash = Mix(ullHash);
+			const BYTE bTag = static_cast<BYTE>(ullHash & 0x7f);
+			for (size_t stGroup = static_cast<size_t>(ullHash >> 7) & stGroupMask;; stGroup = (stGroup + 1) & stGroupMask) {
+				const BYTE *pbTags = &vTags[stGroup * GROUP_SIZE];
+				for (unsigned uMatches = MatchTags(pbTags, bTag); 0 != uMatches; uMatches &= uMatches - 1) {
+					const DWORD dwHandle = vSlots[(stGroup * GROUP_SIZE) + LowestBit(uMatches)];
+					if (match(dwHandle)) {
+						return dwHandle;
+					}
+				}
+				if (0 != MatchTags(pbTags, TAG_EMPTY)) {
+					// Insert fills the first free slot on the probe path, so an empty slot ends it
+					return INVALID_SLOT;
+				}
+			}
+		}
+
+		// Handles below stHandles are already indexed; hashOf(handle, hash) gives the hash of each one
+		// (false if it is not indexed) for rebuilding the index when it grows
+		template <class HashOf>
+		void Insert(ULONGLONG ullHash, DWORD dwHandle, size_t stHandles, HashOf hashOf) {
+			// Keep at most 7/8 of the slots (tombstones included) in use
+			if ((stUsed + 1) * 8 > vTags.size() * 7) {
+				Rebuild(stHandles, hashOf);
+			}
+			Place(Mix(ullHash), dwHandle);
+		}
+
+		void Erase(ULONGLONG ullHash, DWORD dwHandle) {
+			ullHash = Mix(ullHash);
+			const BYTE bTag = static_cast<BYTE>(ullHash & 0x7f);
+			for (size_t stGroup = static_cast<size_t>(ullHash >> 7) & stGroupMask;; stGroup = (stGroup + 1) & stGroupMask) {
+				const BYTE *pbTags = &vTags[stGroup * GROUP_SIZE];
+				for (unsigned uMatches = MatchTags(pbTags, bTag); 0 != uMatches; uMatches &= uMatches - 1) {
+					const size_t stSlot = (stGroup * GROUP_SIZE) + LowestBit(uMatches);
+					if (dwHandle == vSlots[stSlot]) {
+						// Tombstone, so probe paths running through this slot stay intact
+						vTags[stSlot] = TAG_DELETED;
+						return;
+					}
+				}
+				assert(0 == MatchTags(pbTags, TAG_EMPTY));
+			}
+		}
+
+		size_t MemoryUsage() const {
+			return vTags.capacity() + (vSlots.capacity() * sizeof(DWORD));
+		}
+
+	private:
+		static constexpr size_t GROUP_SIZE = 16;
+		static constexpr BYTE TAG_EMPTY = 0x80;
+		static constexpr BYTE TAG_DELETED = 0xfe;
+
+		std::vector<BYTE> vTags; // 7-bit hash tag per slot, or TAG_EMPTY/TAG_DELETED
+		std::vector<DWORD> vSlots;
+		size_t stGroupMask = 0;
+		size_t stUsed = 0; // Occupied and deleted slots
+
+		// Spread the bits so sequential addresses do not share tags or groups (MurmurHash3 finalizer)
+		static ULONGLONG Mix(ULONGLONG ullHash) {
+			ullHash ^= ullHash >> 33;
+			ullHash *= 0xff51afd7ed558ccdULL;
+			ullHash ^= ullHash >> 33;
+			return ullHash;
+		}
+
+		// Bit i is set if tag i of the group equals bTag
+		static unsigned MatchTags(const BYTE *pbTags, BYTE bTag) {
+#ifdef DHCPLITE_SSE2
+			const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pbTags));
+			return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(bTag)))));
+#else
+			unsigned uMatches = 0;
+			for (size_t i = 0; i < GROUP_SIZE; i++) {
+				uMatches |= static_cast<unsigned>(bTag == pbTags[i]) << i;
+			}
+			return uMatches;
+#endif
+		}
+
+		static unsigned LowestBit(unsigned uMask) {
+#if defined(_MSC_VER)
+			unsigned long ulIndex;
+			_BitScanForward(&ulIndex, uMask);
+			return ulIndex;
+#else
+			return static_cast<unsigned>(__builtin_ctz(uMask));
+#endif
+		}
+
+		void Place(ULONGLONG ullMixedHash, DWORD dwHandle) {
+			for (size_t stGroup = static_cast<size_t>(ullMixedHash >> 7) & stGroupMask;; stGroup = (stGroup + 1) & stGroupMask) {
+				// Empty and deleted tags both have the high bit set
+				BYTE *pbTags = &vTags[stGroup * GROUP_SIZE];
+				const unsigned uFree = MatchTags(pbTags, TAG_EMPTY) | MatchTags(pbTags, TAG_DELETED);
+				if (0 != uFree) {
+					const size_t stSlot = (stGroup * GROUP_SIZE) + LowestBit(uFree);
+					if (TAG_EMPTY == vTags[stSlot]) {
+						stUsed++;
+					}
+					vTags[stSlot] = static_cast<BYTE>(ullMixedHash & 0x7f);
+					vSlots[stSlot] = dwHandle;
+					return;
+				}
+			}
+		}
+
+		// Size for twice the handles and re-insert every indexed one, dropping tombstones. An index that
+		// filled up without tombstones doubles.
+		template <class HashOf>
+		void Rebuild(size_t stHandles, HashOf hashOf) {
+			size_t stGroups = 1;
+			while (stGroups * GROUP_SIZE * 7 < stHandles * 2 * 8) {
+				stGroups *= 2;
+			}
+			vTags.assign(stGroups * GROUP_SIZE, TAG_EMPTY);
+			vSlots.assign(stGroups * GROUP_SIZE, 0);
+			stGroupMask = stGroups - 1;
+			stUsed = 0;
+			ULONGLONG ullHash;
+			for (DWORD dwHandle = 0; dwHandle < stHandles; dwHandle++) {
+				if (hashOf(dwHandle, ullHash)) {
+					Place(Mix(ullHash), dwHandle);
+				}
+			}
+		}
+	};
+
+	// Lease store shared by the DHCPv4 and DHCPv6 engines, laid out as parallel arrays (address,
+	// client identifier hash, expiry, identifier location, state) so a million-lease pool costs a few
+	// dozen bytes per lease. Client identifiers are interned in one arena. Leases handed out from a
+	// pool are also linked into that pool's least-recently-seen list, so an exhausted pool can take
+	// back its oldest stale binding without a scan. Only the request thread writes the table and looks
+	// leases up, and it writes what Copy reads while holding the table lock so that Copy is safe from
+	// any other thread.
+	template <class Address, class AddressHash = std::hash<Address>>
+	class LeaseTable {
+	public:
+		// Stable index of a lease in the lease table
+		typedef size_t LeaseHandle;
+		static constexpr LeaseHandle INVALID_LEASE_HANDLE = static_cast<LeaseHandle>(-1);
+		// Pool of leases that are never reclaimed (reservations, circuit policies, the server itself)
+		static constexpr DWORD NO_POOL = static_cast<DWORD>(-1);
+
+		// One lease as copied out of the table
+		struct Lease {
+			Address address;
+			DWORD dwClientIdentifierOffset; // Into the client identifier arena
+			DWORD dwClientIdentifierSize;
+			ULONGLONG ullExpireTime; // Server clock seconds
+			bool bClientIdentifierIndexed; // False if the lease is found some other way (see Add)
+		};
+
+		// Bytes stored per lease in the parallel arrays (the indexes and identifier arena come on top)
+		static constexpr size_t LEASE_BYTES = sizeof(Address) + sizeof(ULONGLONG) + sizeof(ULONGLONG) + sizeof(DWORD) + sizeof(BYTE) + sizeof(BYTE)
+			+ sizeof(ULONGLONG) + sizeof(DWORD) + sizeof(DWORD) + sizeof(DWORD);
+
+		LeaseHandle FindByAddress(const Address &address) const {
+			const DWORD dwHandle = addressIndex.Find(AddressHash()(address), [&](DWORD dwLease) {
+				return address == vAddresses[dwLease];
+			});
+			return (LeaseIndex::INVALID_SLOT != dwHandle) ? dwHandle : INVALID_LEASE_HANDLE;
+		}
+
+		LeaseHandle FindByClientIdentifier(const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize) const {
+			assert((0 != pbClientIdentifier) && (0 != dwClientIdentifierSize));
+
+			const ULONGLONG ullHash = HashClientIdentifier(pbClientIdentifier, dwClientIdentifierSize);
+			const DWORD dwHandle = clientIdentifierIndex.Find(ullHash, [&](DWORD dwLease) {
+				return (ullHash == vClientIdentifierHashes[dwLease]) && HasClientIdentifier(dwLease, pbClientIdentifier, dwClientIdentifierSize);
+			});
+			return (LeaseIndex::INVALID_SLOT != dwHandle) ? dwHandle : INVALID_LEASE_HANDLE;
+		}
+
+		bool HasClientIdentifier(LeaseHandle lhLease, const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize) const {
+			return (dwClientIdentifierSize == vClientIdentifierSizes[lhLease])
+				&& (0 == memcmp(pbClientIdentifier, &vClientIdentifiers[vClientIdentifierOffsets[lhLease]], dwClientIdentifierSize));
+		}
+
+		const Address &GetAddress(LeaseHandle lhLease) const {
+			return vAddresses[lhLease];
+		}
+
+		ULONGLONG GetExpireTime(LeaseHandle lhLease) const {
+			return vExpireTimes[lhLease];
+		}
+
+		// Handles given out so far, removed leases included
+		size_t Size() const {
+			return vAddresses.size();
+		}
+
+		// bIndexClientIdentifier is false for leases found some other way (e.g. by circuit-id); leases in
+		// dwPool may be reclaimed for another client of the same pool once they are stale
+		LeaseHandle Add(const Address &address, const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize, bool bIndexClientIdentifier = true, DWORD dwPool = NO_POOL) {
+			assert(dwClientIdentifierSize <= MAX_CLIENT_IDENTIFIER_LENGTH);
+			std::lock_guard<std::mutex> lock(mLeaseTable);
+
+			const DWORD dwLease = static_cast<DWORD>(vAddresses.size());
+			const ULONGLONG ullHash = HashClientIdentifier(pbClientIdentifier, dwClientIdentifierSize);
+			const bool bIndexed = bIndexClientIdentifier && (0 != dwClientIdentifierSize);
+			vAddresses.push_back(address);
+			vClientIdentifierHashes.push_back(ullHash);
+			vExpireTimes.push_back(LEASE_NEVER_EXPIRES);
+			vClientIdentifierOffsets.push_back(static_cast<DWORD>(vClientIdentifiers.size()));
+			vClientIdentifierSizes.push_back(static_cast<BYTE>(dwClientIdentifierSize));
+			vStates.push_back(bIndexed ? LEASE_STATE_INDEXED : 0);
+			vClientIdentifiers.insert(vClientIdentifiers.end(), pbClientIdentifier, pbClientIdentifier + dwClientIdentifierSize);
+			vLastSeenTimes.push_back(0);
+			vPools.push_back(dwPool);
+			vLruPrevious.push_back(NO_LINK);
+			vLruNext.push_back(NO_LINK);
+			if (NO_POOL != dwPool) {
+				LinkBack(dwLease);
+			}
+
+			addressIndex.Insert(AddressHash()(address), dwLease, dwLease, [this](DWORD dwHandle, ULONGLONG &ullHandleHash) {
+				ullHandleHash = AddressHash()(vAddresses[dwHandle]);
+				return 0 == (vStates[dwHandle] & LEASE_STATE_REMOVED);
+			});
+			if (bIndexed) {
+				clientIdentifierIndex.Insert(ullHash, dwLease, dwLease, [this](DWORD dwHandle, ULONGLONG &ullHandleHash) {
+					ullHandleHash = vClientIdentifierHashes[dwHandle];
+					return 0 != (vStates[dwHandle] & LEASE_STATE_INDEXED);
+				});
+			}
+			ullGeneration++;
+			return dwLease;
+		}
+
+		void SetExpireTime(LeaseHandle lhLease, ULONGLONG ullExpireTime) {
+			std::lock_guard<std::mutex> lock(mLeaseTable);
+			vExpireTimes[lhLease] = ullExpireTime;
+			ullGeneration++;
+		}
+
+		// Record that the client holding the lease was heard from; it becomes the last to be reclaimed
+		void Touch(LeaseHandle lhLease, ULONGLONG ullNow) {
+			const DWORD dwLease = static_cast<DWORD>(lhLease);
+			vLastSeenTimes[dwLease] = ullNow;
+			if (NO_POOL != vPools[dwLease]) {
+				Unlink(dwLease);
+				LinkBack(dwLease);
+			}
+		}
+
+		// Drop the lease, freeing its address for allocation and its client for a new binding. Its handle is
+		// not reused and no longer refers to a lease.
+		void Remove(LeaseHandle lhLease) {
+			const DWORD dwLease = static_cast<DWORD>(lhLease);
+			assert(0 == (vStates[dwLease] & LEASE_STATE_REMOVED));
+			if (NO_POOL != vPools[dwLease]) {
+				Unlink(dwLease);
+				vPools[dwLease] = NO_POOL;
+			}
+
+			std::lock_guard<std::mutex> lock(mLeaseTable);
+			addressIndex.Erase(AddressHash()(vAddresses[dwLease]), dwLease);
+			if (0 != (vStates[dwLease] & LEASE_STATE_INDEXED)) {
+				clientIdentifierIndex.Erase(vClientIdentifierHashes[dwLease], dwLease);
+			}
+			vStates[dwLease] = LEASE_STATE_REMOVED;
+			ullGeneration++;
+		}
+
+		// Make the lease the first to be reclaimed (e.g. after the client released it)
+		void Retire(LeaseHandle lhLease) {
+			const DWORD dwLease = static_cast<DWORD>(lhLease);
+			if (NO_POOL != vPools[dwLease]) {
+				Unlink(dwLease);
+				LinkFront(dwLease);
+			}
+		}
+
+		// Hand the least recently seen lease of dwPool to a new client if it has expired, is an offer
+		// that was never acknowledged, or (for a non-zero ullIdleTime) has not been seen for that long.
+		// Only the list head is considered: every lease behind it was seen more recently. Leases whose
+		// address fails isUsable(address) (e.g. no longer in the pool after a reload) leave the list.
+		template <class IsUsable>
+		LeaseHandle Reclaim(DWORD dwPool, ULONGLONG ullNow, ULONGLONG ullIdleTime, const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize, IsUsable isUsable) {
+			assert((0 != pbClientIdentifier) && (0 != dwClientIdentifierSize) && (dwClientIdentifierSize <= MAX_CLIENT_IDENTIFIER_LENGTH));
+
+			auto itList = mapLruLists.find(dwPool);
+			if (mapLruLists.end() == itList) {
+				return INVALID_LEASE_HANDLE;
+			}
+			for (DWORD dwLease = itList->second.dwHead; NO_LINK != dwLease; dwLease = itList->second.dwHead) {
+				const ULONGLONG ullLastSeen = vLastSeenTimes[dwLease];
+				const bool bStale = (LEASE_NEVER_EXPIRES == vExpireTimes[dwLease])
+					? (ullLastSeen + LEASE_OFFER_HOLD_SECONDS <= ullNow)
+					: ((vExpireTimes[dwLease] <= ullNow) || ((0 != ullIdleTime) && (ullLastSeen + ullIdleTime <= ullNow)));
+				if (!bStale) {
+					return INVALID_LEASE_HANDLE;
+				}
+				if (!isUsable(vAddresses[dwLease])) {
+					Unlink(dwLease);
+					vPools[dwLease] = NO_POOL;
+					continue;
+				}
+
+				std::lock_guard<std::mutex> lock(mLeaseTable);
+				if (0 != (vStates[dwLease] & LEASE_STATE_INDEXED)) {
+					clientIdentifierIndex.Erase(vClientIdentifierHashes[dwLease], dwLease);
+					vStates[dwLease] &= ~LEASE_STATE_INDEXED;
+				}
+				// Reuse the old identifier's bytes when the new one fits
+				if (vClientIdentifierSizes[dwLease] < dwClientIdentifierSize) {
+					vClientIdentifierOffsets[dwLease] = static_cast<DWORD>(vClientIdentifiers.size());
+					vClientIdentifiers.resize(vClientIdentifiers.size() + dwClientIdentifierSize);
+				}
+				memcpy(&vClientIdentifiers[vClientIdentifierOffsets[dwLease]], pbClientIdentifier, dwClientIdentifierSize);
+				vClientIdentifierSizes[dwLease] = static_cast<BYTE>(dwClientIdentifierSize);
+				vClientIdentifierHashes[dwLease] = HashClientIdentifier(pbClientIdentifier, dwClientIdentifierSize);
+				clientIdentifierIndex.Insert(vClientIdentifierHashes[dwLease], dwLease, vAddresses.size(), [this](DWORD dwHandle, ULONGLONG &ullHandleHash) {
+					ullHandleHash = vClientIdentifierHashes[dwHandle];
+					return 0 != (vStates[dwHandle] & LEASE_STATE_INDEXED);
+				});
+				vStates[dwLease] |= LEASE_STATE_INDEXED;
+				vExpireTimes[dwLease] = LEASE_NEVER_EXPIRES;
+				Touch(dwLease, ullNow);
+				ullReclaims++;
+				ullGeneration++;
+				return dwLease;
+			}
+			return INVALID_LEASE_HANDLE;
+		}
+
+		// Take the leases whose address fails isUsable(address) out of dwPool (e.g. after a reload took their
+		// addresses out of the pool's ranges), so they no longer count towards its size. Walks the whole pool.
+		template <class IsUsable>
+		void Prune(DWORD dwPool, IsUsable isUsable) {
+			auto itList = mapLruLists.find(dwPool);
+			if (mapLruLists.end() == itList) {
+				return;
+			}
+			for (DWORD dwLease = itList->second.dwHead; NO_LINK != dwLease;) {
+				const DWORD dwNext = vLruNext[dwLease];
+				if (!isUsable(vAddresses[dwLease])) {
+					Unlink(dwLease);
+					vPools[dwLease] = NO_POOL;
+				}
+				dwLease = dwNext;
+			}
+		}
+
+		// Leases linked into dwPool
+		size_t GetPoolSize(DWORD dwPool) const {
+			auto itList = mapLruLists.find(dwPool);
+			return (mapLruLists.end() != itList) ? itList->second.stCount : 0;
+		}
+
+		// Leases taken over by Reclaim since the table was created
+		ULONGLONG GetReclaimCount() const {
+			std::lock_guard<std::mutex> lock(mLeaseTable);
+			return ullReclaims;
+		}
+
+		// Copy the leases (and nothing else) under the lock, unless the table is still at ullKnownGeneration.
+		// The request thread waits for the lock on its next write, so the buffers are allocated and touched
+		// before the lock is taken and only the copy itself holds it.
+		bool Copy(ULONGLONG ullKnownGeneration, std::vector<Lease> &leases, std::vector<BYTE> &clientIdentifiers, ULONGLONG &ullCopyGeneration) const {
+			size_t stLeases = 0;
+			size_t stClientIdentifierBytes = 0;
+			for (;;) {
+				// Room for what the request thread adds while the buffers are prepared
+				leases.resize(stLeases + (stLeases / 16));
+				clientIdentifiers.resize(stClientIdentifierBytes + (stClientIdentifierBytes / 16));
+
+				std::lock_guard<std::mutex> lock(mLeaseTable);
+				if (ullKnownGeneration == ullGeneration) {
+					return false;
+				}
+				stLeases = vAddresses.size();
+				stClientIdentifierBytes = vClientIdentifiers.size();
+				if ((leases.size() < stLeases) || (clientIdentifiers.size() < stClientIdentifierBytes)) {
+					continue;
+				}
+
+				size_t stCopied = 0;
+				for (size_t i = 0; i < stLeases; i++) {
+					if (0 != (vStates[i] & LEASE_STATE_REMOVED)) continue;
+					leases[stCopied++] = Lease{ vAddresses[i], vClientIdentifierOffsets[i], vClientIdentifierSizes[i], vExpireTimes[i], 0 != (vStates[i] & LEASE_STATE_INDEXED) };
+				}
+				if (0 != stClientIdentifierBytes) {
+					memcpy(clientIdentifiers.data(), vClientIdentifiers.data(), stClientIdentifierBytes);
+				}
+				ullCopyGeneration = ullGeneration;
+				leases.resize(stCopied);
+				clientIdentifiers.resize(stClientIdentifierBytes);
+				return true;
+			}
+		}
+
+		// Bytes allocated for the lease arrays, indexes and client identifier arena
+		size_t MemoryUsage() const {
+			std::lock_guard<std::mutex> lock(mLeaseTable);
+			return (vAddresses.capacity() * sizeof(Address)) + (vClientIdentifierHashes.capacity() * sizeof(ULONGLONG))
+				+ (vExpireTimes.capacity() * sizeof(ULONGLONG)) + (vClientIdentifierOffsets.capacity() * sizeof(DWORD))
+				+ vClientIdentifierSizes.capacity() + vStates.capacity() + vClientIdentifiers.capacity()
+				+ (vLastSeenTimes.capacity() * sizeof(ULONGLONG)) + ((vPools.capacity() + vLruPrevious.capacity() + vLruNext.capacity()) * sizeof(DWORD))
+				+ addressIndex.MemoryUsage() + clientIdentifierIndex.MemoryUsage();
+		}
+
+	private:
+		enum LeaseStates : BYTE {
+			LEASE_STATE_INDEXED = 0x01, // Client identifier is in clientIdentifierIndex
+			LEASE_STATE_REMOVED = 0x02, // Handle no longer refers to a lease (see Remove)
+		};
+
+		std::vector<Address> vAddresses;
+		std::vector<ULONGLONG> vClientIdentifierHashes;
+		std::vector<ULONGLONG> vExpireTimes; // Server clock seconds
+		std::vector<DWORD> vClientIdentifierOffsets; // Into vClientIdentifiers
+		std::vector<BYTE> vClientIdentifierSizes;
+		std::vector<BYTE> vStates; // LeaseStates bits
+		std::vector<BYTE> vClientIdentifiers; // Interned client identifiers, stored once per client
+		LeaseIndex addressIndex;
+		LeaseIndex clientIdentifierIndex;
+		ULONGLONG ullGeneration = 0;
+		ULONGLONG ullReclaims = 0;
+		mutable std::mutex mLeaseTable;
+
+		// Least recently seen first; only the request thread uses these, so they are not locked
+		static constexpr DWORD NO_LINK = static_cast<DWORD>(-1);
+		struct LruList {
+			DWORD dwHead = NO_LINK;
+			DWORD dwTail = NO_LINK;
+			size_t stCount = 0;
+		};
+		std::vector<ULONGLONG> vLastSeenTimes; // Server clock seconds
+		std::vector<DWORD> vPools;
+		std::vector<DWORD> vLruPrevious;
+		std::vector<DWORD> vLruNext;
+		std::unordered_map<DWORD, LruList> mapLruLists; // Keyed by pool
+
+		void Unlink(DWORD dwLease) {
+			LruList &list = mapLruLists[vPools[dwLease]];
+			const DWORD dwPrevious = vLruPrevious[dwLease];
+			const DWORD dwNext = vLruNext[dwLease];
+			((NO_LINK != dwPrevious) ? vLruNext[dwPrevious] : list.dwHead) = dwNext;
+			((NO_LINK != dwNext) ? vLruPrevious[dwNext] : list.dwTail) = dwPrevious;
+			vLruPrevious[dwLease] = NO_LINK;
+			vLruNext[dwLease] = NO_LINK;
+			list.stCount--;
+		}
+
+		void LinkBack(DWORD dwLease) {
+			LruList &list = mapLruLists[vPools[dwLease]];
+			vLruPrevious[dwLease] = list.dwTail;
+			((NO_LINK != list.dwTail) ? vLruNext[list.dwTail] : list.dwHead) = dwLease;
+			list.dwTail = dwLease;
+			list.stCount++;
+		}
+
+		void LinkFront(DWORD dwLease) {
+			LruList &list = mapLruLists[vPools[dwLease]];
+			vLruNext[dwLease] = list.dwHead;
+			((NO_LINK != list.dwHead) ? vLruPrevious[list.dwHead] : list.dwTail) = dwLease;
+			list.dwHead = dwLease;
+			list.stCount++;
+		}
+	};
+
+	// A DHCPv4 lease used to take a 24-byte record plus a hash map node for each index; the LRU links
+	// and last-seen time account for 20 of these bytes
+	static_assert(LeaseTable<DWORD>::LEASE_BYTES <= 48, "DHCPv4 lease arrays should stay within 48 bytes per lease.");
+}
@@ -1,155 +1,152 @@
 #include "DHCPLite.h"
-#include <tchar.h>
+#include "DHCPv6.h"
 #include <assert.h>
+#ifdef _WIN32
 #include <iphlpapi.h>
 #include <iprtrmib.h>
+#else
+#include <ifaddrs.h>
+#include <net/if_arp.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#endif
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <tuple>
 
 using namespace DHCPLite;
 
-size_t DHCPMessage::SetOptionList(std::vector<BYTE> options) {
-	size_t size = 0;
-	for (size_t i = 0; i < options.size(); i++) { // RFC 2132
-		switch (options[i]) {
-		case MsgOption_PAD:
-			continue;
-			break;
-		case MsgOption_END:
-			optionList[options[i]] = std::vector<BYTE>{}; // MsgOption_END
-			return size;
-			break;
-		default:
-		{
-			if (i + 1 >= options.size()) {
-				assert(!(TEXT("Invalid option data (not enough room for required length byte).")));
-				break;
-			}
-
-			BYTE optionLen = options[i + 1];
-			std::vector<BYTE> data(optionLen);
-			std::copy_n(options.begin() + (i + 2), optionLen, data.begin());
-			optionList[options[i]] = data;
-
-			i += 1; // lenght bit
-			i += optionLen; // data bit
-			size++;
-			break;
+// Accepts "0a0b0c", "0a:0b:0c" and "0a-0b-0c"
+static bool HexToBytes(const std::string &text, std::vector<BYTE> &bytes) {
+	bytes.clear();
+	int iHighNibble = -1;
+	for (auto &&c : text) {
+		int iNibble;
+		if ('0' <= c && c <= '9') iNibble = c - '0';
+		else if ('a' <= c && c <= 'f') iNibble = c - 'a' + 10;
+		else if ('A' <= c && c <= 'F') iNibble = c - 'A' + 10;
+		else if ((':' == c || '-' == c) && (-1 == iHighNibble)) continue;
+		else return false;
+
+		if (-1 == iHighNibble) {
+			iHighNibble = iNibble;
 		}
+		else {
+			bytes.push_back(static_cast<BYTE>((iHighNibble << 4) | iNibble));
+			iHighNibble = -1;
 		}
 	}
-	return size;
+	return (-1 == iHighNibble) && !bytes.empty();
 }
 
-DHCPMessage::DHCPMessage() : body() {
-	BYTE *pBody = reinterpret_cast<BYTE *>(&body);
-	std::fill_n(pBody, sizeof(MessageBody), 0);
-}
+// Dotted quad to network order address (usable before WinSock is initialized)
+static bool StringToIPAddr(const std::string &text, DWORD &address) {
+	BYTE *addrBytes = (BYTE *)&address;
+	size_t stPosition = 0;
+	for (size_t i = 0; i < 4; i++) {
+		size_t stDigits = 0;
+		unsigned int uValue = 0;
+		while ((stPosition < text.size()) && ('0' <= text[stPosition]) && (text[stPosition] <= '9') && (stDigits < 3)) {
+			uValue = uValue * 10 + (text[stPosition++] - '0');
+			stDigits++;
+		}
+		if ((0 == stDigits) || (255 < uValue)) return false;
+		addrBytes[i] = static_cast<BYTE>(uValue);
 
-DHCPMessage::DHCPMessage(std::vector<BYTE> data) {
-	SetData(data);
+		if (3 != i) {
+			if ((stPosition >= text.size()) || ('.' != text[stPosition])) return false;
+			stPosition++;
+		}
+	}
+	return stPosition == text.size();
 }
 
-std::vector<BYTE> DHCPMessage::GetData() {
-	std::vector<BYTE> data(sizeof(MessageBody));
-	BYTE *pBody = reinterpret_cast<BYTE *>(&body);
-	std::copy_n(pBody, sizeof(MessageBody), data.begin());
-
-	for (auto &&option : optionList) {
-		data.push_back(option.first);
-
-		std::vector<BYTE> optionData = option.second;
-		auto optionDataSize = optionData.size();
-		if (optionDataSize == 0) continue;
-
-		data.push_back(static_cast<BYTE>(optionDataSize));
+LeaseSnapshot::LeaseSnapshot(ULONGLONG generation, std::vector<LeaseInformation> leases)
+	: generation(generation), leases(std::move(leases)) {
+	std::sort(this->leases.begin(), this->leases.end(), [](const LeaseInformation &a, const LeaseInformation &b) {
+		return DHCPServer::IPtoValue(a.address) < DHCPServer::IPtoValue(b.address);
+		});
 
-		auto dataSize = data.size();
-		data.resize(dataSize + optionDataSize);
-		std::copy_n(optionData.begin(), optionDataSize, data.begin() + dataSize);
+	clientIndex.reserve(this->leases.size());
+	for (size_t i = 0; i < this->leases.size(); i++) {
+		if (this->leases[i].circuit) continue;
+		const auto &clientIdentifier = this->leases[i].clientIdentifier;
+		clientIndex.emplace_back(HashClientIdentifier(clientIdentifier.data(), clientIdentifier.size()), i);
 	}
-
-	return data;
+	std::sort(clientIndex.begin(), clientIndex.end());
 }
 
-void DHCPMessage::SetData(std::vector<BYTE> data) {
-	// Take into account mandatory DHCP magic cookie values in options array (RFC 2131 section 3)
-	if (data.size() < sizeof(MessageBody))
-		throw MessageException("Invalid DHCP message (failed initial checks).");
-
-	BYTE *pBody = reinterpret_cast<BYTE *>(&body);
-	std::copy_n(data.begin(), sizeof(MessageBody), pBody);
-
-	std::vector<BYTE> options(data.size() - sizeof(MessageBody));
-	options.assign(data.begin() + sizeof(MessageBody), data.end());
-	SetOptionList(options);
+ULONGLONG LeaseSnapshot::GetGeneration() const {
+	return generation;
 }
 
-std::vector<BYTE> DHCPMessage::GetOptionRaw(MessageOptionValues option) {
-	if (optionList.find(option) != optionList.end()) {
-		return optionList[option];
-	}
-
-	return std::vector<BYTE>{};
+const std::vector<LeaseSnapshot::LeaseInformation> &LeaseSnapshot::GetLeases() const {
+	return leases;
 }
 
-template <class T> T DHCPMessage::GetOption(MessageOptionValues option) {
-	auto raw = GetOptionRaw(option);
-	auto rawSize = raw.size();
-	if (rawSize <= 0) return T{};
+const LeaseSnapshot::LeaseInformation *LeaseSnapshot::FindByAddress(DWORD address) const {
+	const DWORD dwAddrValue = DHCPServer::IPtoValue(address);
+	auto it = std::lower_bound(leases.begin(), leases.end(), dwAddrValue, [](const LeaseInformation &lease, DWORD value) {
+		return DHCPServer::IPtoValue(lease.address) < value;
+		});
+	return ((leases.end() != it) && (it->address == address)) ? &*it : nullptr;
+}
 
-	if (rawSize < sizeof(T))
-		throw MessageException("Invalid DHCP message option (size exceeds actual size).");
+const LeaseSnapshot::LeaseInformation *LeaseSnapshot::FindByClientIdentifier(const std::vector<BYTE> &clientIdentifier) const {
+	if (clientIdentifier.empty()) return nullptr;
 
-	if (std::is_same_v<T, BYTE>) {
-		return raw[0];
-	}
-	else if (std::is_same_v<T, WORD>) {
-		return static_cast<T>(*reinterpret_cast<WORD *>(raw.data()));
-	}
-	else if (std::is_same_v<T, DWORD>) {
-		return static_cast<T>(*reinterpret_cast<DWORD *>(raw.data()));
+	const ULONGLONG ullHash = HashClientIdentifier(clientIdentifier.data(), clientIdentifier.size());
+	for (auto it = std::lower_bound(clientIndex.begin(), clientIndex.end(), std::make_pair(ullHash, size_t{ 0 }));
+		(clientIndex.end() != it) && (ullHash == it->first); ++it) {
+		if (leases[it->second].clientIdentifier == clientIdentifier) {
+			return &leases[it->second];
+		}
 	}
-
-	return T{};
+	return nullptr;
 }
 
-void DHCPMessage::SetOptionRaw(MessageOptionValues option, std::vector<BYTE> data) {
-	optionList[option] = data;
-}
+DHCPServer::LeaseHandle DHCPServer::FindLeaseByCircuit(const std::vector<BYTE> &circuitId) {
+	if (circuitId.empty()) return INVALID_LEASE_HANDLE;
 
-template <class T> void DHCPMessage::SetOption(MessageOptionValues option, T data) {
-	if (std::is_same_v<T, BYTE>) {
-		optionList[option] = PByteToVByte(reinterpret_cast<BYTE *>(&data), 1);
-	}
-	else if (std::is_same_v<T, WORD>) {
-		optionList[option] = PByteToVByte(reinterpret_cast<BYTE*>(&data), 2);
-	}
-	else if (std::is_same_v<T, DWORD>) {
-		optionList[option] = PByteToVByte(reinterpret_cast<BYTE *>(&data), 4);
-	}
-	else {
-		throw MessageException("Invalid DHCP message option type.");
+	auto range = mapLeaseByCircuit.equal_range(HashClientIdentifier(circuitId.data(), circuitId.size()));
+	for (auto it = range.first; it != range.second; ++it) {
+		if (leaseTable.HasClientIdentifier(it->second, circuitId.data(), static_cast<DWORD>(circuitId.size()))) {
+			return it->second;
+		}
 	}
+	return INVALID_LEASE_HANDLE;
 }
 
-void DHCPLite::DHCPMessage::SetOption(MessageOptionValues option) {
-	optionList[option] = std::vector<BYTE>{};
+ULONGLONG DHCPServer::GetTime() {
+	return ClockCallback ? ClockCallback() : (GetTickCount64() / 1000);
 }
 
-std::vector<BYTE> DHCPMessage::PByteToVByte(const BYTE *data, int size) {
-	std::vector<BYTE> bytes(size);
-	std::copy_n(data, size, bytes.begin());
-	return bytes;
-}
+std::shared_ptr<const LeaseSnapshot> DHCPServer::GetLeaseSnapshot() {
+	std::lock_guard<std::mutex> snapshotLock(mLeaseSnapshot);
 
-int DHCPServer::FindIndexOf(const VectorAddressInUseInformation *const pvAddressesInUse, FindIndexOfFilter pFilter) {
-	assert((0 != pvAddressesInUse) && (0 != pFilter));
+	// Copy the flat lease arrays while holding the table lock, which holds up the request thread's next lease
+	// change for as long as the copy takes; everything else happens outside it
+	std::vector<LeaseTable<DWORD>::Lease> vLeases;
+	std::vector<BYTE> vIdentifiers;
+	ULONGLONG ullGeneration;
+	if (!leaseTable.Copy(spLeaseSnapshot ? spLeaseSnapshot->GetGeneration() : ~0ULL, vLeases, vIdentifiers, ullGeneration)) {
+		return spLeaseSnapshot;
+	}
 
-	for (size_t i = 0; i < pvAddressesInUse->size(); i++) {
-		if (pFilter(pvAddressesInUse->at(i))) {
-			return (int)i;
-		}
+	std::vector<LeaseSnapshot::LeaseInformation> leases;
+	leases.reserve(vLeases.size());
+	for (auto &&lease : vLeases) {
+		auto itIdentifier = vIdentifiers.begin() + lease.dwClientIdentifierOffset;
+		// Circuit policy reservations are the only leases with an identifier that is not indexed
+		leases.push_back(LeaseSnapshot::LeaseInformation{ ValuetoIP(lease.address),
+			std::vector<BYTE>(itIdentifier, itIdentifier + lease.dwClientIdentifierSize), lease.ullExpireTime,
+			!lease.bClientIdentifierIndexed && (0 != lease.dwClientIdentifierSize) });
 	}
-	return -1;
+	spLeaseSnapshot = std::make_shared<const LeaseSnapshot>(ullGeneration, std::move(leases));
+	return spLeaseSnapshot;
 }
 
 bool DHCPServer::InitializeDHCPServer() {
@@ -166,10 +163,20 @@ bool DHCPServer::InitializeDHCPServer() {
 
 	SOCKADDR_IN saServerAddress{};
 	saServerAddress.sin_family = AF_INET;
+#ifdef _WIN32
 	saServerAddress.sin_addr.s_addr = config.addrInfo.address;  // Already in network byte order
+#else
+	// Linux does not deliver broadcasts to a socket bound to a unicast address, so bind to any address on the interface instead
+	saServerAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+	char pcsInterfaceName[IF_NAMESIZE]{};
+	if ((nullptr == if_indextoname(config.addrInfo.index, pcsInterfaceName))
+		|| (NO_ERROR != setsockopt(sServerSocket, SOL_SOCKET, SO_BINDTODEVICE, pcsInterfaceName, static_cast<socklen_t>(strlen(pcsInterfaceName))))) {
+		throw SocketException("Unable to bind server socket to its interface.");
+	}
+#endif
 	saServerAddress.sin_port = htons((u_short)DHCP_SERVER_PORT);
 	const int iServerAddressSize = sizeof(saServerAddress);
-	if (SOCKET_ERROR == bind(sServerSocket, (SOCKADDR *)(&saServerAddress), iServerAddressSize)) {
+	if (SOCKET_ERROR == ::bind(sServerSocket, (SOCKADDR *)(&saServerAddress), iServerAddressSize)) {
 		throw SocketException("Unable to bind to server socket (port 67).");
 	}
 
@@ -181,13 +188,269 @@ bool DHCPServer::InitializeDHCPServer() {
 	return true;
 }
 
-void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iDataSize) {
-	const BYTE MAGIC_COOKIE[4]{ 0x63, 0x82, 0x53, 0x63 }; // DHCP magic cookie values
+bool DHCPServer::InitializeDHCPv6Server() {
+	// Clients send to All_DHCP_Relay_Agents_and_Servers (RFC 8415 section 7.1) from their link-local address
+	sServerSocket6 = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (INVALID_SOCKET == sServerSocket6) {
+		throw SocketException("Unable to open DHCPv6 server socket (port 547).");
+	}
+
+	SOCKADDR_IN6 saServerAddress{};
+	saServerAddress.sin6_family = AF_INET6;
+	saServerAddress.sin6_addr = in6addr_any;
+	saServerAddress.sin6_port = htons((u_short)DHCPV6_SERVER_PORT);
+	if (SOCKET_ERROR == ::bind(sServerSocket6, (SOCKADDR *)(&saServerAddress), sizeof(saServerAddress))) {
+		throw SocketException("Unable to bind to DHCPv6 server socket (port 547).");
+	}
+
+	IPV6_MREQ mreqGroup{};
+	if ((1 != inet_pton(AF_INET6, "ff02::1:2", &mreqGroup.ipv6mr_multiaddr))) {
+		throw SocketException("Unable to parse the DHCPv6 multicast address.");
+	}
+	mreqGroup.ipv6mr_interface = config.addrInfo.index;
+	if (NO_ERROR != setsockopt(sServerSocket6, IPPROTO_IPV6, IPV6_JOIN_GROUP, (char *)(&mreqGroup), sizeof(mreqGroup))) {
+		throw SocketException("Unable to join the DHCPv6 multicast group.");
+	}
+
+	return true;
+}
+
+std::shared_ptr<const RuntimeConfig> DHCPServer::CompileConfig(const DHCPConfig &config) const {
+	auto runtimeConfig = std::make_shared<RuntimeConfig>();
+
+	std::vector<SubnetConfig> subnets = config.subnets;
+	if (subnets.empty()) {
+		// No configured subnets - serve the auto-detected range on our own subnet
+		SubnetConfig subnet{};
+		subnet.network = config.addrInfo.address & config.addrInfo.mask;
+		subnet.mask = config.addrInfo.mask;
+		subnet.pools.emplace_back(config.minAddr, config.maxAddr);
+		subnets.push_back(subnet);
+	}
+
+	// Reserved addresses and our own address are never handed out dynamically
+	std::vector<std::pair<DWORD, DWORD>> reservedRanges{ { IPtoValue(config.addrInfo.address), IPtoValue(config.addrInfo.address) } };
+	for (auto &&reservation : config.reservations) {
+		if (reservation.hardwareAddress.empty()) {
+			throw ConfigException("Invalid reservation (empty hardware address).");
+		}
+		const DWORD dwAddrValue = IPtoValue(reservation.address);
+		reservedRanges.emplace_back(dwAddrValue, dwAddrValue);
+		runtimeConfig->mapReservations[std::string(reservation.hardwareAddress.begin(), reservation.hardwareAddress.end())] = dwAddrValue;
+	}
+	for (auto &&policy : config.circuitPolicies) {
+		reservedRanges.emplace_back(IPtoValue(policy.address), IPtoValue(policy.address));
+	}
+
+	std::sort(reservedRanges.begin(), reservedRanges.end());
+
+	runtimeConfig->vSubnets.reserve(subnets.size());
+	for (auto &&subnet : subnets) {
+		SubnetRuntime subnetRuntime{};
+		subnetRuntime.dwMaskValue = IPtoValue(subnet.mask);
+		subnetRuntime.dwNetworkValue = IPtoValue(subnet.network) & subnetRuntime.dwMaskValue;
+		subnetRuntime.dwLeaseTime = htonl(subnet.leaseTime);
+		subnetRuntime.dwIdleReclaimTime = subnet.idleReclaimTime;
+
+		std::vector<std::pair<DWORD, DWORD>> pools;
+		// Only the reserved addresses inside this subnet matter to its ranges
+		auto itFirstReserved = std::lower_bound(reservedRanges.begin(), reservedRanges.end(), std::make_pair(subnetRuntime.dwNetworkValue, DWORD{ 0 }));
+		auto itLastReserved = std::upper_bound(itFirstReserved, reservedRanges.end(), std::make_pair(subnetRuntime.dwNetworkValue | ~subnetRuntime.dwMaskValue, ~DWORD{ 0 }));
+		std::vector<std::pair<DWORD, DWORD>> exclusions(itFirstReserved, itLastReserved);
+		for (auto &&pool : subnet.pools) {
+			const DWORD dwFirstValue = IPtoValue(pool.first);
+			const DWORD dwLastValue = IPtoValue(pool.second);
+			if ((dwFirstValue > dwLastValue)
+				|| ((dwFirstValue & subnetRuntime.dwMaskValue) != subnetRuntime.dwNetworkValue)
+				|| ((dwLastValue & subnetRuntime.dwMaskValue) != subnetRuntime.dwNetworkValue)) {
+				throw ConfigException("Invalid pool " + IPAddrToString(pool.first) + "-" + IPAddrToString(pool.second) + " (outside its subnet or reversed).");
+			}
+			pools.emplace_back(dwFirstValue, dwLastValue);
+		}
+		for (auto &&exclusion : subnet.exclusions) {
+			exclusions.emplace_back(IPtoValue(exclusion.first), IPtoValue(exclusion.second));
+		}
+		subnetRuntime.vRanges = SubtractRanges(std::move(pools), std::move(exclusions));
+		for (auto &&range : subnetRuntime.vRanges) {
+			subnetRuntime.ullRangeSize += static_cast<ULONGLONG>(range.second) - range.first + 1;
+		}
+
+		for (auto &&option : subnet.options) {
+			if (!IsValidOptionLength(OptionSchemaTable[option.first], option.second.size())
+				|| (OptionType::Empty == OptionSchemaTable[option.first].type)) {
+				throw ConfigException("Invalid value for option " + std::to_string(option.first) + ".");
+			}
+			subnetRuntime.vOptions.emplace_back(option.first, option.second);
+		}
+
+		// RFC 2131 section 4.3.5 - DHCPACK carrying configuration only (no yiaddr, no lease time)
+		DHCPMessage replyMessage;
+		replyMessage.body.op = DHCPMessage::MsgOp_BOOT_REPLY;
+		const size_t snameSize = min(serverName.size() + 1, sizeof(replyMessage.body.sname)); // Room for the terminator
+		strncpy_s((char *)(replyMessage.body.sname), snameSize, serverName.c_str(), _TRUNCATE);
+		replyMessage.body.magicCookie = *reinterpret_cast<const DWORD *>(MAGIC_COOKIE);
+		replyMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_ACK);
+		replyMessage.SetOption<DHCPMessage::MsgOption_SUBNET_MASK>(subnet.mask); // Already in network order
+		replyMessage.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(config.addrInfo.address); // Already in network order
+		for (auto &&option : subnetRuntime.vOptions) {
+			replyMessage.SetOptionRaw(static_cast<DHCPMessage::MessageOptionValues>(option.first), option.second);
+		}
+		replyMessage.SetOption(DHCPMessage::MsgOption_END);
+		subnetRuntime.vInformReplyTemplate = replyMessage.GetData();
+
+		runtimeConfig->vSubnets.push_back(std::move(subnetRuntime));
+	}
+
+	std::sort(runtimeConfig->vSubnets.begin(), runtimeConfig->vSubnets.end(), [](const SubnetRuntime &a, const SubnetRuntime &b) {
+		return a.dwNetworkValue < b.dwNetworkValue;
+		});
+	for (size_t i = 1; i < runtimeConfig->vSubnets.size(); i++) {
+		const SubnetRuntime &previous = runtimeConfig->vSubnets[i - 1];
+		if ((runtimeConfig->vSubnets[i].dwNetworkValue & previous.dwMaskValue) == previous.dwNetworkValue) {
+			throw ConfigException("Overlapping subnets " + IPAddrToString(ValuetoIP(previous.dwNetworkValue)) + " and "
+				+ IPAddrToString(ValuetoIP(runtimeConfig->vSubnets[i].dwNetworkValue)) + ".");
+		}
+	}
+
+	// Subnets whose ranges are unchanged keep their generation, so the allocator only re-checks the pools a reload changed
+	const auto previousConfig = std::atomic_load(&spRuntimeConfig);
+	if (previousConfig) {
+		runtimeConfig->ullGeneration = previousConfig->ullGeneration + 1;
+	}
+	for (auto &&subnetRuntime : runtimeConfig->vSubnets) {
+		const SubnetRuntime *pPrevious = previousConfig ? FindSubnet(*previousConfig, subnetRuntime.dwNetworkValue) : nullptr;
+		subnetRuntime.ullRangesGeneration = ((nullptr != pPrevious) && (pPrevious->dwNetworkValue == subnetRuntime.dwNetworkValue)
+			&& (pPrevious->vRanges == subnetRuntime.vRanges)) ? pPrevious->ullRangesGeneration : runtimeConfig->ullGeneration;
+	}
+
+	return runtimeConfig;
+}
+
+void DHCPServer::ProcessDHCPInformRequest(const DHCPMessage &requestMessage, char *pcsClientHostName, PacketTrace &trace) {
+	// The client already has an address, so the lease table is not consulted
+	const DWORD dwClientAddr = requestMessage.body.ciaddr;
+	const auto runtimeConfig = std::atomic_load(&spRuntimeConfig);
+	const SubnetRuntime *pSubnet = FindSubnet(*runtimeConfig,
+		IPtoValue((0 != requestMessage.body.giaddr) ? requestMessage.body.giaddr : dwClientAddr));
+	if (nullptr == pSubnet) {
+		// Not one of our subnets - fail silently
+		return;
+	}
+	trace.Mark(Stage_LOOKUP);
+
+	// Stamp the per-request fields onto a copy of the template
+	vInformReplyBuffer.assign(pSubnet->vInformReplyTemplate.begin(), pSubnet->vInformReplyTemplate.end());
+	DHCPMessage::MessageBody *pReplyBody = reinterpret_cast<DHCPMessage::MessageBody *>(vInformReplyBuffer.data());
+	pReplyBody->htype = requestMessage.body.htype;
+	pReplyBody->hlen = requestMessage.body.hlen;
+	pReplyBody->xid = requestMessage.body.xid;
+	pReplyBody->flags = requestMessage.body.flags;
+	pReplyBody->ciaddr = dwClientAddr;
+	pReplyBody->giaddr = requestMessage.body.giaddr;
+	std::copy_n(requestMessage.body.chaddr, sizeof(pReplyBody->chaddr), pReplyBody->chaddr);
+
+	// Relay Agent Information - echoed verbatim ahead of the template's END option (RFC 3046 section 2.2)
+	auto relayAgentInformationRaw = requestMessage.GetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION);
+	if (!relayAgentInformationRaw.empty()) {
+		assert(DHCPMessage::MsgOption_END == vInformReplyBuffer.back());
+		vInformReplyBuffer.back() = DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION;
+		vInformReplyBuffer.push_back(static_cast<BYTE>(relayAgentInformationRaw.size()));
+		vInformReplyBuffer.insert(vInformReplyBuffer.end(), relayAgentInformationRaw.begin(), relayAgentInformationRaw.end());
+		vInformReplyBuffer.push_back(DHCPMessage::MsgOption_END);
+		pReplyBody = reinterpret_cast<DHCPMessage::MessageBody *>(vInformReplyBuffer.data());
+	}
+
+	// RFC 2131 section 4.1 - DHCPACK to DHCPINFORM is unicast to ciaddr
+	DWORD ulAddr = dwClientAddr;
+	if (0 != requestMessage.body.giaddr) {
+		ulAddr = requestMessage.body.giaddr;  // Already in network order
+		pReplyBody->flags |= BROADCAST_FLAG;  // Indicate to the relay agent that it must broadcast
+	}
+	else if (0 == ulAddr) {
+		ulAddr = INADDR_BROADCAST;
+	}
+	trace.Mark(Stage_ENCODE);
+	SendDHCPReply(vInformReplyBuffer.data(), static_cast<int>(vInformReplyBuffer.size()), ulAddr);
+	trace.Mark(Stage_SEND);
+	trace.result = Result_REPLIED;
+
+	if (MessageCallback_Inform) {
+		MessageCallback_Inform(pcsClientHostName, dwClientAddr);
+	}
+}
+
+void DHCPServer::SendDHCPReply(const BYTE *pbData, int iDataSize, DWORD ulAddr) {
+	assert((INADDR_LOOPBACK != ulAddr) && (0 != ulAddr));
+	if (SendCallback) {
+		SendCallback(pbData, iDataSize, ulAddr);
+		return;
+	}
+
+	SOCKADDR_IN saClientAddress{};
+	saClientAddress.sin_family = AF_INET;
+	saClientAddress.sin_addr.s_addr = ulAddr;
+	saClientAddress.sin_port = htons((u_short)DHCP_CLIENT_PORT);
+	[[maybe_unused]] const int iBytesSent = sendto(sServerSocket, reinterpret_cast<const char *>(pbData),
+		iDataSize, 0, (SOCKADDR *)&saClientAddress, sizeof(saClientAddress));
+	assert(SOCKET_ERROR != iBytesSent);
+}
+
+bool DHCPServer::SetClientHardwareAddress(DWORD dwClientAddr, const BYTE *pbHardwareAddr, BYTE bHardwareAddrSize) {
+	// The client cannot answer ARP before it has accepted the address, so seed the ARP cache with chaddr
+	// to let the IP stack unicast straight to the hardware address (RFC 2131 section 4.1)
+	if (!bUnicastToHardwareAddress || SendCallback || (0 == config.addrInfo.index)
+		|| (0 == bHardwareAddrSize) || (MAXLEN_PHYSADDR < bHardwareAddrSize)) {
+		return false;
+	}
 
+#ifdef _WIN32
+	MIB_IPNETROW minrClientRow{};
+	minrClientRow.dwIndex = config.addrInfo.index;
+	minrClientRow.dwPhysAddrLen = bHardwareAddrSize;
+	CopyMemory(minrClientRow.bPhysAddr, pbHardwareAddr, bHardwareAddrSize);
+	minrClientRow.dwAddr = dwClientAddr;  // Already in network order
+	minrClientRow.dwType = MIB_IPNET_TYPE_DYNAMIC;  // Let the entry age out normally
+
+	DWORD dwResult = CreateIpNetEntry(&minrClientRow);
+	if (ERROR_OBJECT_ALREADY_EXISTS == dwResult) {
+		dwResult = SetIpNetEntry(&minrClientRow);
+	}
+	if (ERROR_ACCESS_DENIED == dwResult) {
+		// Not running elevated - stop trying and broadcast from now on
+		bUnicastToHardwareAddress = false;
+	}
+	return NO_ERROR == dwResult;
+#else
+	arpreq arClientEntry{};
+	SOCKADDR_IN *const psaClientAddress = reinterpret_cast<SOCKADDR_IN *>(&arClientEntry.arp_pa);
+	psaClientAddress->sin_family = AF_INET;
+	psaClientAddress->sin_addr.s_addr = dwClientAddr;  // Already in network order
+	arClientEntry.arp_ha.sa_family = ARPHRD_ETHER;
+	CopyMemory(arClientEntry.arp_ha.sa_data, pbHardwareAddr, bHardwareAddrSize);
+	arClientEntry.arp_flags = ATF_COM;  // Not ATF_PERM - let the entry age out normally
+	if (nullptr == if_indextoname(config.addrInfo.index, arClientEntry.arp_dev)) {
+		return false;
+	}
+
+	if (SOCKET_ERROR == ioctl(sServerSocket, SIOCSARP, &arClientEntry)) {
+		if (EPERM == errno) {
+			// Missing CAP_NET_ADMIN - stop trying and broadcast from now on
+			bUnicastToHardwareAddress = false;
+		}
+		return false;
+	}
+	return true;
+#endif
+}
+
+void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iDataSize, PacketTrace &trace) {
 	DHCPMessage requestMessage(DHCPMessage::PByteToVByte(pbData, iDataSize));
 
 	DHCPMessage::MessageTypes messageType =
-		static_cast<DHCPMessage::MessageTypes>(requestMessage.GetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE));
+		static_cast<DHCPMessage::MessageTypes>(requestMessage.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	trace.xid = ntohl(requestMessage.body.xid); // As it appears on the wire, like DHCPv6 transaction ids
+	trace.messageType = static_cast<BYTE>(messageType);
+	trace.Mark(Stage_PARSE);
 
 	if (requestMessage.body.op != DHCPMessage::MsgOp_BOOT_REQUEST
 		|| 0 != std::memcmp(MAGIC_COOKIE, &requestMessage.body.magicCookie, sizeof(MAGIC_COOKIE)))
@@ -204,12 +467,19 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 
 	const unsigned int stHostNameCopySize = min(iRequestHostNameDataSize + 1,
 		static_cast<u_int>(sizeof(pcsClientHostName)));
-	_tcsncpy_s(pcsClientHostName, stHostNameCopySize, (char *)pbRequestHostNameData, _TRUNCATE);
+	if (0 != iRequestHostNameDataSize) {
+		strncpy_s(pcsClientHostName, stHostNameCopySize, (char *)pbRequestHostNameData, _TRUNCATE);
+	}
 
 	if ('\0' != pcsServerHostName[0] && 0 == _stricmp(pcsClientHostName, pcsServerHostName)) {
 		// Ignore attempts by the DHCP server to obtain a DHCP address (possible if its current address was obtained by auto-IP) because this would invalidate dwServerAddr
 	}
 
+	if (DHCPMessage::MsgType_INFORM == messageType) {
+		ProcessDHCPInformRequest(requestMessage, pcsClientHostName, trace);
+		return;
+	}
+
 	// Determine client identifier in proper RFC 2131 order (client identifier option then chaddr)
 	const BYTE *pbRequestClientIdentifierData;
 	unsigned int iRequestClientIdentifierDataSize;
@@ -223,19 +493,48 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 		iRequestClientIdentifierDataSize = sizeof(requestMessage.body.chaddr);
 	}
 
+	// Determine the subnet being served - the relay agent's for relayed requests, otherwise our own
+	const auto runtimeConfig = std::atomic_load(&spRuntimeConfig);
+	const SubnetRuntime *pSubnet = FindSubnet(*runtimeConfig,
+		IPtoValue((0 != requestMessage.body.giaddr) ? requestMessage.body.giaddr : config.addrInfo.address));
+	if (nullptr == pSubnet) {
+		// Not one of our subnets - fail silently
+		return;
+	}
+	// Only a lease on the subnet being served is any use to the client; an address anywhere else is off-link for it
+	auto isOnSubnet = [this, pSubnet](LeaseHandle lhLease) {
+		return (leaseTable.GetAddress(lhLease) & pSubnet->dwMaskValue) == pSubnet->dwNetworkValue;
+	};
+
 	// Determine if we've seen this client before
 	bool bSeenClientBefore = false;
 	DWORD dwClientPreviousOfferAddr = (DWORD)INADDR_BROADCAST;  // Invalid IP address for later comparison
-	auto cid = std::make_tuple(pbRequestClientIdentifierData, (DWORD)iRequestClientIdentifierDataSize);
-	const int iIndex = FindIndexOf(&vAddressesInUse, [=](const AddressInUseInformation &raiui) {
-		return (0 != raiui.dwClientIdentifierSize) && (iRequestClientIdentifierDataSize == raiui.dwClientIdentifierSize)
-			&& (0 == memcmp(pbRequestClientIdentifierData, raiui.pbClientIdentifier, iRequestClientIdentifierDataSize));
-		});
-	if (-1 != iIndex) {
-		const AddressInUseInformation aiui = vAddressesInUse.at((size_t)iIndex);
-		dwClientPreviousOfferAddr = ValuetoIP(aiui.dwAddrValue);
+	// Relay agent circuit policies take precedence over the client identifier (RFC 3046)
+	auto relayAgentInformation = requestMessage.GetRelayAgentInformation();
+	LeaseHandle lhClientLease = FindLeaseByCircuit(relayAgentInformation.circuitId);
+	if ((INVALID_LEASE_HANDLE != lhClientLease) && !isOnSubnet(lhClientLease)) {
+		// Circuit-id also used behind a relay agent on another subnet
+		lhClientLease = INVALID_LEASE_HANDLE;
+	}
+	if (INVALID_LEASE_HANDLE == lhClientLease) {
+		lhClientLease = leaseTable.FindByClientIdentifier(pbRequestClientIdentifierData, iRequestClientIdentifierDataSize);
+		if ((INVALID_LEASE_HANDLE != lhClientLease) && !isOnSubnet(lhClientLease)) {
+			// The client has moved to another subnet (e.g. it is now behind a different relay agent), so it is served
+			// as a new client: a REQUEST for its old address gets a NAK, and a DISCOVER drops the old binding to make
+			// room for one on this subnet
+			if (DHCPMessage::MsgType_DISCOVER == messageType) {
+				leaseTable.Remove(lhClientLease);
+			}
+			lhClientLease = INVALID_LEASE_HANDLE;
+		}
+	}
+	if (INVALID_LEASE_HANDLE != lhClientLease) {
+		dwClientPreviousOfferAddr = ValuetoIP(leaseTable.GetAddress(lhClientLease));
 		bSeenClientBefore = true;
+		leaseTable.Touch(lhClientLease, GetTime());
 	}
+	trace.Mark(Stage_LOOKUP);
+
 	// Server message handling
 	// RFC 2131 section 4.3
 	DHCPMessage replyMessage;
@@ -251,21 +550,29 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 	replyMessage.body.giaddr = requestMessage.body.giaddr;
 
 	std::copy_n(requestMessage.body.chaddr, sizeof(replyMessage.body.chaddr), replyMessage.body.chaddr);
-	int snameSize = sizeof(replyMessage.body.sname);
-	if (serverName.size() < snameSize) snameSize = static_cast<int>(serverName.size());
+	const size_t snameSize = min(serverName.size() + 1, sizeof(replyMessage.body.sname)); // Room for the terminator
 	strncpy_s((char *)(replyMessage.body.sname), snameSize, serverName.c_str(), _TRUNCATE);
 	// replyMessage.body.file = 0;
 	// set options below
 	replyMessage.body.magicCookie = *reinterpret_cast<const DWORD*>(MAGIC_COOKIE);
 	// DHCP Message Type - RFC 2132 section 9.6
-	replyMessage.SetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE, DHCPMessage::MsgType_DISCOVER);
+	replyMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_DISCOVER);
 	// IP Address Lease Time - RFC 2132 section 9.2
-	C_ASSERT(sizeof(u_long) == 4);
-	replyMessage.SetOption(DHCPMessage::MsgOption_ADDRESS_LEASETIME, htonl(1 * 60 * 60)); // One hour
+	C_ASSERT(sizeof(pSubnet->dwLeaseTime) == 4);
+	replyMessage.SetOption<DHCPMessage::MsgOption_ADDRESS_LEASETIME>(pSubnet->dwLeaseTime); // Already in network order
 	// Subnet Mask - RFC 2132 section 3.3
-	replyMessage.SetOption(DHCPMessage::MsgOption_SUBNET_MASK, config.addrInfo.mask); // Already in network order
+	replyMessage.SetOption<DHCPMessage::MsgOption_SUBNET_MASK>(ValuetoIP(pSubnet->dwMaskValue));
 	// Server Identifier - RFC 2132 section 9.7
-	replyMessage.SetOption(DHCPMessage::MsgOption_SERVER_IDENTIFIER, config.addrInfo.address); // Already in network order
+	replyMessage.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(config.addrInfo.address); // Already in network order
+	// Configured options
+	for (auto &&option : pSubnet->vOptions) {
+		replyMessage.SetOptionRaw(static_cast<DHCPMessage::MessageOptionValues>(option.first), option.second);
+	}
+	// Relay Agent Information - echoed verbatim (RFC 3046 section 2.2)
+	auto relayAgentInformationRaw = requestMessage.GetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION);
+	if (!relayAgentInformationRaw.empty()) {
+		replyMessage.SetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION, relayAgentInformationRaw);
+	}
 	// END
 	replyMessage.SetOption(DHCPMessage::MsgOption_END);
 
@@ -275,62 +582,26 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 	{
 		// RFC 2131 section 4.3.1
 		// UNSUPPORTED: Requested IP Address option
-		static DWORD dwServerLastOfferAddrValue = IPtoValue(config.maxAddr);  // Initialize to max to wrap and offer min first
-		const DWORD dwMinAddrValue = IPtoValue(config.minAddr);
-		const DWORD dwMaxAddrValue = IPtoValue(config.maxAddr);
 		DWORD dwOfferAddrValue;
-		bool bOfferAddrValueValid = false;
+		assert((0 != iRequestClientIdentifierDataSize) && (0 != pbRequestClientIdentifierData));
 		if (bSeenClientBefore) {
 			dwOfferAddrValue = IPtoValue(dwClientPreviousOfferAddr);
-			bOfferAddrValueValid = true;
 		}
 		else {
-			dwOfferAddrValue = dwServerLastOfferAddrValue + 1;
-		}
-		// Search for an available address if necessary
-		const DWORD dwInitialOfferAddrValue = dwOfferAddrValue;
-		bool bOfferedInitialValue = false;
-		while (!bOfferAddrValueValid && !(bOfferedInitialValue && (dwInitialOfferAddrValue == dwOfferAddrValue)))  // Detect address exhaustion
-		{
-			if (dwMaxAddrValue < dwOfferAddrValue) {
-				assert(dwMaxAddrValue + 1 == dwOfferAddrValue);
-				dwOfferAddrValue = dwMinAddrValue;
+			const LeaseHandle lhLease = addressAllocator.AllocateLease(*runtimeConfig, *pSubnet, requestMessage.body.chaddr, requestMessage.body.hlen,
+				pbRequestClientIdentifierData, iRequestClientIdentifierDataSize, GetTime());
+			if (INVALID_LEASE_HANDLE == lhLease) {
+				throw RequestException("No more IP addresses available for client.");
 			}
-			bOfferAddrValueValid = (-1 == FindIndexOf(&vAddressesInUse, [=](const AddressInUseInformation &raiui) {
-				return dwOfferAddrValue == raiui.dwAddrValue;
-				}));
-			bOfferedInitialValue = true;
-			if (!bOfferAddrValueValid) {
-				dwOfferAddrValue++;
-			}
-		}
-		if (!bOfferAddrValueValid) {
-			throw RequestException("No more IP addresses available for client.");
+			dwOfferAddrValue = leaseTable.GetAddress(lhLease);
 		}
-		dwServerLastOfferAddrValue = dwOfferAddrValue;
 		const DWORD dwOfferAddr = ValuetoIP(dwOfferAddrValue);
-		assert((0 != iRequestClientIdentifierDataSize) && (0 != pbRequestClientIdentifierData));
-		AddressInUseInformation aiuiClientAddress{};
-		aiuiClientAddress.dwAddrValue = dwOfferAddrValue;
-		aiuiClientAddress.pbClientIdentifier = (BYTE *)LocalAlloc(LMEM_FIXED, iRequestClientIdentifierDataSize);
-		if (0 != aiuiClientAddress.pbClientIdentifier) {
-			CopyMemory(aiuiClientAddress.pbClientIdentifier, pbRequestClientIdentifierData, iRequestClientIdentifierDataSize);
-			aiuiClientAddress.dwClientIdentifierSize = iRequestClientIdentifierDataSize;
-
-			vAddressesInUse.push_back(aiuiClientAddress);
-			replyMessage.body.yiaddr = dwOfferAddr;
-			replyMessage.SetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE, DHCPMessage::MsgType_OFFER);
-			bSendDHCPMessage = true;
+		replyMessage.body.yiaddr = dwOfferAddr;
+		replyMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_OFFER);
+		bSendDHCPMessage = true;
 
+		if (MessageCallback_Discover) {
 			MessageCallback_Discover(pcsClientHostName, dwOfferAddr);
-
-			if (bSeenClientBefore) {
-				LocalFree(aiuiClientAddress.pbClientIdentifier);
-			}
-		}
-		else {
-			LocalFree(aiuiClientAddress.pbClientIdentifier);
-			throw RequestException("Insufficient memory to add client address.");
 		}
 	}
 	break;
@@ -339,25 +610,28 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 		// RFC 2131 section 4.3.2
 		// Determine requested IP address
 		DWORD dwRequestedIPAddress = INADDR_BROADCAST;  // Invalid IP address for later comparison
-		auto requestedIPAddressRaw = requestMessage.GetOptionRaw(DHCPMessage::MsgOption_REQUESTED_ADDRESS);
-		if (requestedIPAddressRaw.size() > 0) {
-			dwRequestedIPAddress = *reinterpret_cast<DWORD*>(requestedIPAddressRaw.data());
+		auto requestedIPAddress = requestMessage.GetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>();
+		if (0 != requestedIPAddress) {
+			dwRequestedIPAddress = requestedIPAddress;
 		}
 
 		// Determine server identifier
-		auto serverIdentifier = requestMessage.GetOption<DWORD>(DHCPMessage::MsgOption_SERVER_IDENTIFIER);
-		if (serverIdentifier != config.addrInfo.address) {
+		auto serverIdentifier = requestMessage.GetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>();
+		if (0 != serverIdentifier) {
 			// Response to OFFER
 			// DHCPREQUEST generated during SELECTING state
 			assert(0 == requestMessage.body.ciaddr);
-			if (bSeenClientBefore) {
+			if (serverIdentifier != config.addrInfo.address) {
+				// Client accepted another server's offer - nothing to send
+			}
+			else if (bSeenClientBefore) {
 				// Already have an IP address for this client - ACK it
-				replyMessage.SetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE, DHCPMessage::MsgType_ACK);
+				replyMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_ACK);
 				// Will set other options below
 			}
 			else {
 				// Haven't seen this client before - NAK it
-				replyMessage.SetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE, DHCPMessage::MsgType_NAK);
+				replyMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_NAK);
 				// Will clear invalid options and prepare to send message below
 			}
 		}
@@ -370,16 +644,16 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 			// Unicast -> DHCPREQUEST generated during RENEWING state / Broadcast -> DHCPREQUEST generated during REBINDING state
 			if (bSeenClientBefore && ((dwClientPreviousOfferAddr == dwRequestedIPAddress) || (dwClientPreviousOfferAddr == requestMessage.body.ciaddr))) {
 				// Already have an IP address for this client - ACK it
-				replyMessage.SetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE, DHCPMessage::MsgType_ACK);
+				replyMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_ACK);
 				// Will set other options below
 			}
 			else {
 				// Haven't seen this client before or requested IP address is invalid
-				replyMessage.SetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE, DHCPMessage::MsgType_NAK);
+				replyMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_NAK);
 				// Will clear invalid options and prepare to send message below
 			}
 		}
-		switch (replyMessage.GetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE)) {
+		switch (replyMessage.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>()) {
 		case DHCPMessage::MsgType_ACK:
 			assert(INADDR_BROADCAST != dwClientPreviousOfferAddr);
 
@@ -387,13 +661,19 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 			replyMessage.body.yiaddr = dwClientPreviousOfferAddr;
 			bSendDHCPMessage = true;
 
-			MessageCallback_ACK(pcsClientHostName, dwClientPreviousOfferAddr);
+			leaseTable.SetExpireTime(lhClientLease, GetTime() + ntohl(pSubnet->dwLeaseTime));
+
+			if (MessageCallback_ACK) {
+				MessageCallback_ACK(pcsClientHostName, dwClientPreviousOfferAddr);
+			}
 			break;
 		case DHCPMessage::MsgType_NAK:
 			C_ASSERT(0 == DHCPMessage::MsgOption_PAD);
 			bSendDHCPMessage = true;
 
-			MessageCallback_NAK(pcsClientHostName, dwClientPreviousOfferAddr);
+			if (MessageCallback_NAK) {
+				MessageCallback_NAK(pcsClientHostName, dwClientPreviousOfferAddr);
+			}
 			break;
 		default:
 			// Nothing to do
@@ -404,10 +684,14 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 	case DHCPMessage::MsgType_DECLINE:
 		// Fall-through
 	case DHCPMessage::MsgType_RELEASE:
-		// UNSUPPORTED: Mark address as unused
+		// RFC 2131 section 4.3.4 - the binding is kept so the client gets the same address back, but its lease ends now
+		if (bSeenClientBefore && (DHCPMessage::MsgType_RELEASE == messageType) && (dwClientPreviousOfferAddr == requestMessage.body.ciaddr)) {
+			leaseTable.SetExpireTime(lhClientLease, GetTime());
+			leaseTable.Retire(lhClientLease);
+		}
 		break;
 	case DHCPMessage::MsgType_INFORM:
-		// Unsupported DHCP message type - fail silently
+		assert(!(TEXT("DHCPINFORM is answered before lease lookup.")));
 		break;
 	case DHCPMessage::MsgType_OFFER:
 	case DHCPMessage::MsgType_ACK:
@@ -418,14 +702,15 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 		assert(!"Invalid DHCPMessageType");
 		break;
 	}
+	trace.Mark(Stage_ALLOCATE);
 	if (bSendDHCPMessage) {
 		// Must have set an option if we're going to be sending this message
-		assert(0 != replyMessage.GetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE));
+		assert(0 != replyMessage.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
 		// Determine how to send the reply
 		// RFC 2131 section 4.1
-		u_long ulAddr = INADDR_LOOPBACK;  // Invalid value
+		DWORD ulAddr = INADDR_LOOPBACK;  // Invalid value
 		if (0 == requestMessage.body.giaddr) {
-			switch (replyMessage.GetOption<BYTE>(DHCPMessage::MsgOption_MESSAGE_TYPE)) {
+			switch (replyMessage.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>()) {
 			case DHCPMessage::MsgType_OFFER:
 				// Fall-through
 			case DHCPMessage::MsgType_ACK:
@@ -435,9 +720,9 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 						ulAddr = INADDR_BROADCAST;
 					}
 					else {
-						ulAddr = requestMessage.body.yiaddr;  // Already in network order
-						if (0 == ulAddr) {
-							// UNSUPPORTED: Unicast to hardware address
+						ulAddr = replyMessage.body.yiaddr;  // Already in network order
+						if ((0 == ulAddr) || !SetClientHardwareAddress(ulAddr, requestMessage.body.chaddr, requestMessage.body.hlen)) {
+							// Unable to unicast to hardware address
 							// Instead, broadcast the response and rely on other DHCP clients to ignore it
 							ulAddr = INADDR_BROADCAST;
 						}
@@ -462,44 +747,275 @@ void DHCPServer::ProcessDHCPClientRequest(const BYTE *const pbData, const int iD
 			ulAddr = requestMessage.body.giaddr;  // Already in network order
 			replyMessage.body.flags |= BROADCAST_FLAG;  // Indicate to the relay agent that it must broadcast
 		}
-		assert((INADDR_LOOPBACK != ulAddr) && (0 != ulAddr));
-		SOCKADDR_IN saClientAddress{};
-		saClientAddress.sin_family = AF_INET;
-		saClientAddress.sin_addr.s_addr = ulAddr;
-		saClientAddress.sin_port = htons((u_short)DHCP_CLIENT_PORT);
 		auto replyMessageData = replyMessage.GetData();
-		assert(SOCKET_ERROR != sendto(sServerSocket, reinterpret_cast<char*>(replyMessageData.data()),
-			static_cast<int>(replyMessageData.size()), 0, (SOCKADDR *)&saClientAddress, sizeof(saClientAddress)));
+		trace.Mark(Stage_ENCODE);
+		SendDHCPReply(replyMessageData.data(), static_cast<int>(replyMessageData.size()), ulAddr);
+		trace.Mark(Stage_SEND);
+		trace.result = Result_REPLIED;
 	}
 }
 
-bool DHCPServer::ReadDHCPClientRequests() {
-	BYTE *const pbReadBuffer = (BYTE *)LocalAlloc(LMEM_FIXED, MAX_UDP_MESSAGE_SIZE);
-	if (0 == pbReadBuffer) {
-		throw RequestException("Unable to allocate memory for client datagram read buffer.");
+bool DHCPServer::HandleDHCPClientRequest(const BYTE *pbData, int iDataSize, ULONGLONG ullReceiveTime) {
+	PacketTrace trace{};
+	trace.stageTime[Stage_RECV] = ullReceiveTime;
+	try {
+		ProcessDHCPClientRequest(pbData, iDataSize, trace);
+	}
+	catch (const std::exception &e) {
+		// A malformed or unserviceable request costs only itself, never the receive loop
+		trace.result = Result_DROPPED;
+		flightRecorder.Record(trace, pbData, iDataSize, e.what());
+		return false;
 	}
+	flightRecorder.Record(trace, pbData, iDataSize);
+	return true;
+}
+
+bool DHCPServer::HandleDHCPv6ClientRequest(const BYTE *pbData, int iDataSize, ULONGLONG ullReceiveTime, const SOCKADDR_IN6 *psaClientAddress, std::vector<BYTE> &reply) {
+	PacketTrace trace{};
+	trace.stageTime[Stage_RECV] = ullReceiveTime;
+	trace.messageType = TRACE_DHCPV6_MESSAGE;
+	reply.clear();
+	try {
+		if (upDHCPv6Engine->ProcessRequest(pbData, iDataSize, reply, trace)) {
+			if (nullptr != psaClientAddress) {
+				// Replies go straight back to the client's link-local address and port (RFC 8415 section 18.3)
+				[[maybe_unused]] const int iBytesSent = sendto(sServerSocket6, reinterpret_cast<const char *>(reply.data()),
+					static_cast<int>(reply.size()), 0, (const SOCKADDR *)psaClientAddress, sizeof(*psaClientAddress));
+				assert(static_cast<int>(reply.size()) == iBytesSent);
+			}
+			trace.Mark(Stage_SEND);
+			trace.result = Result_REPLIED;
+		}
+		else {
+			reply.clear();
+		}
+	}
+	catch (const std::exception &e) {
+		reply.clear();
+		trace.result = Result_DROPPED;
+		flightRecorder.Record(trace, pbData, iDataSize, e.what());
+		return false;
+	}
+	flightRecorder.Record(trace, pbData, iDataSize);
+	return true;
+}
+
+bool DHCPServer::ReadDHCPClientRequests() {
+	std::vector<BYTE> vReadBuffer(MAX_UDP_MESSAGE_SIZE);
+	BYTE *const pbReadBuffer = vReadBuffer.data();
+	std::vector<BYTE> vReply6;
 
 	int iLastError = 0;
 	while (WSAENOTSOCK != iLastError) {
+		// WinSock has no batched receive; with DHCPv6 enabled one select() waits on both sockets so a
+		// single thread serves both protocols. Close() invalidates the sockets, so work from copies.
+		const SOCKET sSocket = sServerSocket;
+		const SOCKET sSocket6 = sServerSocket6;
+		if (INVALID_SOCKET == sSocket) {
+			break;
+		}
+		// The signal that asked for the reload also interrupted the wait below, so it is seen straight away
+		if (bReloadRequested.load(std::memory_order_relaxed) && bReloadRequested.exchange(false)) {
+			const std::string result = ReloadConfigFile();
+			if (ReloadCallback) {
+				ReloadCallback(result);
+			}
+		}
+		bool bReadable = true;
+		bool bReadable6 = false;
+		if (INVALID_SOCKET != sSocket6) {
+			fd_set fdsRead;
+			FD_ZERO(&fdsRead);
+			FD_SET(sSocket, &fdsRead);
+			FD_SET(sSocket6, &fdsRead);
+			// WinSock ignores the descriptor count; POSIX needs the highest descriptor plus one
+			if (SOCKET_ERROR == select(static_cast<int>(max(sSocket, sSocket6)) + 1, &fdsRead, nullptr, nullptr, nullptr)) {
+				iLastError = WSAGetLastError();
+				if (iLastError != WSAENOTSOCK && iLastError != WSAEINTR) {
+					throw SocketException("Call to select returned error.");
+				}
+				continue;
+			}
+			bReadable = (0 != FD_ISSET(sSocket, &fdsRead));
+			bReadable6 = (0 != FD_ISSET(sSocket6, &fdsRead));
+		}
+
+		if (bReadable6) {
+			SOCKADDR_IN6 saClientAddress{};
+			socklen_t iClientAddressSize = sizeof(saClientAddress);
+			const int iBytesReceived = recvfrom(sSocket6, (char *)pbReadBuffer, MAX_UDP_MESSAGE_SIZE, 0, (SOCKADDR *)(&saClientAddress), &iClientAddressSize);
+			if (SOCKET_ERROR != iBytesReceived) {
+				HandleDHCPv6ClientRequest(pbReadBuffer, iBytesReceived, FlightRecorder::Now(), &saClientAddress, vReply6);
+			}
+			else {
+				// Per-datagram errors are skipped; a closed socket shows up on the DHCPv4 socket as well
+				iLastError = WSAGetLastError();
+				if (iLastError == WSAENOTSOCK) {
+					break;
+				}
+			}
+		}
+		if (!bReadable) {
+			continue;
+		}
+
 		SOCKADDR_IN saClientAddress{};
-		int iClientAddressSize = sizeof(saClientAddress);
-		const int iBytesReceived = recvfrom(sServerSocket, (char *)pbReadBuffer, MAX_UDP_MESSAGE_SIZE, 0, (SOCKADDR *)(&saClientAddress), &iClientAddressSize);
+		socklen_t iClientAddressSize = sizeof(saClientAddress);
+		const int iBytesReceived = recvfrom(sSocket, (char *)pbReadBuffer, MAX_UDP_MESSAGE_SIZE, 0, (SOCKADDR *)(&saClientAddress), &iClientAddressSize);
 		if (SOCKET_ERROR != iBytesReceived) {
 			// assert(DHCP_CLIENT_PORT == ntohs(saClientAddress.sin_port));  // Not always the case
-			ProcessDHCPClientRequest(pbReadBuffer, iBytesReceived);
+			HandleDHCPClientRequest(pbReadBuffer, iBytesReceived, FlightRecorder::Now());
 		}
 		else {
 			iLastError = WSAGetLastError();
+			if (iLastError == WSAECONNRESET || iLastError == WSAEMSGSIZE) {
+				// Per-datagram errors (ICMP port unreachable for an earlier reply, oversized datagram) - keep reading
+				continue;
+			}
 			if (iLastError != WSAENOTSOCK && iLastError != WSAEINTR) {
-				LocalFree(pbReadBuffer);
 				throw SocketException("Call to recvfrom returned error.");
 			}
 		}
 	}
-	LocalFree(pbReadBuffer);
 	return true;
 }
 
+std::string DHCPServer::ReloadConfigFile() {
+	std::string path;
+	{
+		std::lock_guard<std::mutex> lock(mConfig);
+		path = configFile;
+	}
+	if (path.empty()) return "no configuration file\n";
+
+	try {
+		if (!Reload(LoadDHCPConfig(path, config))) {
+			return "reloaded; circuit and DHCPv6 changes take effect at restart\n";
+		}
+	}
+	catch (const DHCPException &e) {
+		// The running configuration is left as it was
+		return std::string(e.what()) + "\n";
+	}
+	return "reloaded\n";
+}
+
+std::string DHCPServer::ProcessControlRequest(const std::string &request) {
+	auto formatLease = [](const LeaseSnapshot::LeaseInformation &lease) {
+		static const char HEX_DIGITS[] = "0123456789abcdef";
+		std::string line = IPAddrToString(lease.address) + (lease.circuit ? " circuit:" : " ");
+		for (auto &&b : lease.clientIdentifier) {
+			line.push_back(HEX_DIGITS[b >> 4]);
+			line.push_back(HEX_DIGITS[b & 0xf]);
+		}
+		return line + "\n";
+	};
+
+	const size_t stSeparator = request.find(' ');
+	const std::string command = request.substr(0, stSeparator);
+	const std::string argument = (std::string::npos != stSeparator) ? request.substr(stSeparator + 1) : "";
+
+	if ("reload" == command) {
+		return ReloadConfigFile();
+	}
+
+	if ("stats" == command) {
+		const PacketStatistics statistics = GetPacketStatistics();
+		return "received " + std::to_string(statistics.received) + "\nreplied " + std::to_string(statistics.replied)
+			+ "\nignored " + std::to_string(statistics.ignored) + "\ndropped " + std::to_string(statistics.dropped)
+			+ "\nslow " + std::to_string(statistics.slow) + "\nreclaimed " + std::to_string(GetReclaimCount()) + "\nlease-table-bytes " + std::to_string(GetLeaseTableMemoryUsage()) + "\n";
+	}
+	else if ("trace" == command) {
+		return GetPacketTrace();
+	}
+
+	if ("leases6" == command) {
+		static const char HEX_DIGITS[] = "0123456789abcdef";
+		std::string response;
+		if (upDHCPv6Engine) {
+			for (auto &&lease : upDHCPv6Engine->GetLeases()) {
+				response += IPv6AddressToString(lease.address) + " ";
+				for (auto &&b : lease.clientIdentifier) {
+					response.push_back(HEX_DIGITS[b >> 4]);
+					response.push_back(HEX_DIGITS[b & 0xf]);
+				}
+				response += "\n";
+			}
+		}
+		return response;
+	}
+
+	auto snapshot = GetLeaseSnapshot();
+	if ("leases" == command) {
+		std::string response;
+		for (auto &&lease : snapshot->GetLeases()) {
+			response += formatLease(lease);
+		}
+		return response;
+	}
+	else if ("lease" == command) {
+		DWORD dwAddr;
+		if (!StringToIPAddr(argument, dwAddr)) return "invalid address\n";
+		const LeaseSnapshot::LeaseInformation *pLease = snapshot->FindByAddress(dwAddr);
+		return (nullptr != pLease) ? formatLease(*pLease) : "not found\n";
+	}
+	else if ("client" == command) {
+		std::vector<BYTE> clientIdentifier;
+		if (!HexToBytes(argument, clientIdentifier)) return "invalid client identifier\n";
+		const LeaseSnapshot::LeaseInformation *pLease = snapshot->FindByClientIdentifier(clientIdentifier);
+		return (nullptr != pLease) ? formatLease(*pLease) : "not found\n";
+	}
+	return "unknown command\n";
+}
+
+void DHCPServer::ReadControlRequests() {
+	for (;;) {
+		const SOCKET sClientSocket = accept(sControlSocket, nullptr, nullptr);
+		if (INVALID_SOCKET == sClientSocket) {
+			const int iLastError = WSAGetLastError();
+			if (WSAENOTSOCK == iLastError || WSAEINTR == iLastError || INVALID_SOCKET == sControlSocket) {
+				break;
+			}
+			continue;
+		}
+
+		// Connections are served one at a time, so one that sends nothing (or reads nothing) must not hold up the rest
+#ifdef _WIN32
+		const DWORD controlTimeout = CONTROL_TIMEOUT_MILLISECONDS;
+#else
+		const timeval controlTimeout{ CONTROL_TIMEOUT_MILLISECONDS / 1000, (CONTROL_TIMEOUT_MILLISECONDS % 1000) * 1000 };
+#endif
+		setsockopt(sClientSocket, SOL_SOCKET, SO_RCVTIMEO, (char *)(&controlTimeout), sizeof(controlTimeout));
+		setsockopt(sClientSocket, SOL_SOCKET, SO_SNDTIMEO, (char *)(&controlTimeout), sizeof(controlTimeout));
+
+		// One command line per connection
+		char pcsRequest[MAX_HOSTNAME_LENGTH]{};
+		const int iBytesReceived = recv(sClientSocket, pcsRequest, sizeof(pcsRequest) - 1, 0);
+		if (0 < iBytesReceived) {
+			std::string request(pcsRequest, iBytesReceived);
+			request.erase(request.find_last_not_of("\r\n ") + 1);
+
+			std::string response;
+			try {
+				response = ProcessControlRequest(request);
+			}
+			catch (const DHCPException &e) {
+				response = std::string(e.what()) + "\n";
+			}
+			catch (const std::exception &) {
+				response = "invalid request\n";
+			}
+			for (size_t stSent = 0; stSent < response.size();) {
+				const int iBytesSent = send(sClientSocket, response.data() + stSent, static_cast<int>(response.size() - stSent), 0);
+				if (SOCKET_ERROR == iBytesSent) break;
+				stSent += iBytesSent;
+			}
+		}
+		closesocket(sClientSocket);
+	}
+}
+
 
 DWORD DHCPServer::IPtoValue(DWORD ip) {
 	// Convert between big and small endian order
@@ -532,6 +1048,7 @@ std::string DHCPServer::IPAddrToString(DWORD address) {
 std::vector<DHCPServer::IPAddrInfo> DHCPServer::GetIPAddrInfoList() {
 	std::vector<IPAddrInfo> infoList;
 
+#ifdef _WIN32
 	MIB_IPADDRTABLE miatIpAddrTable;
 	ULONG ulIpAddrTableSize = sizeof(miatIpAddrTable);
 	DWORD dwGetIpAddrTableResult = GetIpAddrTable(&miatIpAddrTable, &ulIpAddrTableSize, FALSE);
@@ -556,10 +1073,26 @@ std::vector<DHCPServer::IPAddrInfo> DHCPServer::GetIPAddrInfoList() {
 	const MIB_IPADDRTABLE *const pmiatIpAddrTable = (MIB_IPADDRTABLE *)pbIpAddrTableBuffer;
 
 	for (size_t i = 0; i < pmiatIpAddrTable->dwNumEntries; i++) {
-		infoList.push_back(IPAddrInfo{ pmiatIpAddrTable->table[i].dwAddr, pmiatIpAddrTable->table[i].dwMask });
+		infoList.push_back(IPAddrInfo{ pmiatIpAddrTable->table[i].dwAddr, pmiatIpAddrTable->table[i].dwMask, pmiatIpAddrTable->table[i].dwIndex });
 	}
 
 	LocalFree(pbIpAddrTableBuffer);
+#else
+	ifaddrs *piaAddrList = nullptr;
+	if (SOCKET_ERROR == getifaddrs(&piaAddrList)) {
+		throw IPAddrException("Unable to query IP address table.");
+	}
+
+	for (const ifaddrs *piaAddr = piaAddrList; nullptr != piaAddr; piaAddr = piaAddr->ifa_next) {
+		if ((nullptr == piaAddr->ifa_addr) || (AF_INET != piaAddr->ifa_addr->sa_family) || (nullptr == piaAddr->ifa_netmask)) {
+			continue;
+		}
+		infoList.push_back(IPAddrInfo{ reinterpret_cast<const SOCKADDR_IN *>(piaAddr->ifa_addr)->sin_addr.s_addr,
+			reinterpret_cast<const SOCKADDR_IN *>(piaAddr->ifa_netmask)->sin_addr.s_addr, if_nametoindex(piaAddr->ifa_name) });
+	}
+
+	freeifaddrs(piaAddrList);
+#endif
 	return infoList;
 }
 
@@ -582,6 +1115,7 @@ DHCPServer::DHCPConfig DHCPServer::GetDHCPConfig() {
 	}
 
 	const DWORD dwMask = addrInfoList[tableIndex].mask;
+	const DWORD dwIndex = addrInfoList[tableIndex].index;
 	const DWORD dwAddrValue = DHCPServer::IPtoValue(dwAddr);
 	const DWORD dwMaskValue = DHCPServer::IPtoValue(dwMask);
 	const DWORD dwMinAddrValue = ((dwAddrValue & dwMaskValue) | 2);  // Skip x.x.x.1 (default router address)
@@ -593,7 +1127,181 @@ DHCPServer::DHCPConfig DHCPServer::GetDHCPConfig() {
 		throw IPAddrException("No network is available on this machine. [The subnet mask is incorrect.]");
 	}
 
-	return DHCPServer::DHCPConfig{ dwAddr, dwMask, dwMinAddr, dwMaxAddr };
+	return DHCPServer::DHCPConfig{ { dwAddr, dwMask, dwIndex }, dwMinAddr, dwMaxAddr };
+}
+
+DHCPServer::DHCPConfig DHCPServer::LoadDHCPConfig(const std::string &path, DHCPConfig config) {
+	// Line oriented: one keyword and its arguments per line, '#' starts a comment
+	//   subnet <network> <mask>
+	//     pool <first> <last>
+	//     exclude <first> <last>
+	//     lease-time <seconds>
+	//     reclaim-idle <seconds>
+	//     option <name or code> <value...>
+	//   reserve <hardware address> <address>
+	//   circuit <hex circuit-id> <address>
+	//   prefix6 <address>/<length>
+	//   lifetime6 <preferred seconds> <valid seconds>
+	//   dns6 <address...>
+	//   duid6 <hex server DUID>
+	static const std::map<std::string, BYTE> OPTION_NAMES{
+		{ "router", DHCPMessage::MsgOption_ROUTER },
+		{ "dns", DHCPMessage::MsgOption_DOMAIN_NAME_SERVER },
+		{ "domain-name", DHCPMessage::MsgOption_DOMAIN_NAME },
+		{ "broadcast", DHCPMessage::MsgOption_BROADCAST_ADDRESS },
+		{ "ntp", DHCPMessage::MsgOption_NTP_SERVERS },
+		{ "renewal-time", DHCPMessage::MsgOption_RENEWAL_TIME },
+		{ "rebinding-time", DHCPMessage::MsgOption_REBINDING_TIME },
+	};
+
+	std::ifstream file(path);
+	if (!file) {
+		throw ConfigException("Unable to open configuration file " + path + ".");
+	}
+
+	config.subnets.clear();
+	config.reservations.clear();
+	config.circuitPolicies.clear();
+	config.dhcpv6 = DHCPv6Config{};
+
+	std::string line;
+	for (size_t stLine = 1; std::getline(file, line); stLine++) {
+		auto fail = [&](const char *reason) {
+			return ConfigException(path + "(" + std::to_string(stLine) + "): " + reason);
+		};
+		auto address = [&](std::istringstream &stream) {
+			std::string text;
+			DWORD dwAddr;
+			if (!(stream >> text) || !StringToIPAddr(text, dwAddr)) throw fail("invalid IP address.");
+			return dwAddr;
+		};
+		auto address6 = [&](const std::string &text) {
+			IPv6Address ipv6Address;
+			if (!StringToIPv6Address(text, ipv6Address)) throw fail("invalid IPv6 address.");
+			return ipv6Address;
+		};
+
+		std::istringstream stream(line.substr(0, line.find('#')));
+		std::string keyword;
+		if (!(stream >> keyword)) continue;
+
+		if ("subnet" == keyword) {
+			SubnetConfig subnet{};
+			subnet.network = address(stream);
+			subnet.mask = address(stream);
+			config.subnets.push_back(subnet);
+		}
+		else if ("reserve" == keyword || "circuit" == keyword) {
+			std::string hex;
+			std::vector<BYTE> bytes;
+			if (!(stream >> hex) || !HexToBytes(hex, bytes)) throw fail("invalid hexadecimal value.");
+			if ("reserve" == keyword) {
+				config.reservations.push_back(Reservation{ bytes, address(stream) });
+			}
+			else {
+				config.circuitPolicies.push_back(CircuitPolicy{ bytes, address(stream) });
+			}
+		}
+		else if ("prefix6" == keyword) {
+			std::string text;
+			stream >> text;
+			const size_t stSlash = text.find('/');
+			const std::string length = (std::string::npos != stSlash) ? text.substr(stSlash + 1) : "";
+			if (length.empty() || (3 < length.size()) || !std::all_of(length.begin(), length.end(), ::isdigit)
+				|| (0 == std::stoi(length)) || (120 < std::stoi(length))) throw fail("invalid IPv6 prefix (expected <address>/<1 to 120>).");
+			config.dhcpv6.prefix = address6(text.substr(0, stSlash));
+			config.dhcpv6.prefixLength = static_cast<BYTE>(std::stoi(length));
+		}
+		else if ("lifetime6" == keyword) {
+			DWORD dwPreferred, dwValid;
+			if (!(stream >> dwPreferred >> dwValid) || (0 == dwPreferred) || (dwValid < dwPreferred)) throw fail("invalid lifetimes.");
+			config.dhcpv6.preferredLifetime = dwPreferred;
+			config.dhcpv6.validLifetime = dwValid;
+		}
+		else if ("dns6" == keyword) {
+			std::string text;
+			while (stream >> text) {
+				config.dhcpv6.dnsServers.push_back(address6(text));
+			}
+		}
+		else if ("duid6" == keyword) {
+			std::string hex;
+			if (!(stream >> hex) || !HexToBytes(hex, config.dhcpv6.serverDuid) || (config.dhcpv6.serverDuid.size() < 2)) throw fail("invalid DUID.");
+		}
+		else if (config.subnets.empty()) {
+			throw fail("expected subnet before pool, exclude, lease-time, reclaim-idle or option.");
+		}
+		else if ("pool" == keyword || "exclude" == keyword) {
+			const DWORD dwFirst = address(stream);
+			const DWORD dwLast = address(stream);
+			auto &ranges = ("pool" == keyword) ? config.subnets.back().pools : config.subnets.back().exclusions;
+			ranges.emplace_back(dwFirst, dwLast);
+		}
+		else if ("lease-time" == keyword) {
+			if (!(stream >> config.subnets.back().leaseTime) || (0 == config.subnets.back().leaseTime)) throw fail("invalid lease time.");
+		}
+		else if ("reclaim-idle" == keyword) {
+			if (!(stream >> config.subnets.back().idleReclaimTime) || (0 == config.subnets.back().idleReclaimTime)) throw fail("invalid idle time.");
+		}
+		else if ("option" == keyword) {
+			std::string name;
+			stream >> name;
+			int iCode = -1;
+			auto itName = OPTION_NAMES.find(name);
+			if (OPTION_NAMES.end() != itName) {
+				iCode = itName->second;
+			}
+			else if (!name.empty() && std::all_of(name.begin(), name.end(), ::isdigit) && (name.size() <= 3)) {
+				iCode = std::stoi(name);
+			}
+			if ((iCode <= DHCPMessage::MsgOption_PAD) || (DHCPMessage::MsgOption_END <= iCode)) throw fail("unknown option.");
+
+			// The value is parsed according to the option schema
+			std::vector<BYTE> data;
+			switch (OptionSchemaTable[iCode].type) {
+			case OptionType::Address:
+			case OptionType::AddressList:
+				while (!stream.eof()) {
+					const DWORD dwAddr = address(stream);
+					data.insert(data.end(), (BYTE *)&dwAddr, (BYTE *)&dwAddr + sizeof(dwAddr));
+					stream >> std::ws;
+				}
+				break;
+			case OptionType::Byte:
+			case OptionType::Word:
+			case OptionType::DWord:
+			{
+				const size_t stSize = (OptionType::Byte == OptionSchemaTable[iCode].type) ? 1 : (OptionType::Word == OptionSchemaTable[iCode].type) ? 2 : 4;
+				ULONGLONG ullValue;
+				if (!(stream >> ullValue) || (ullValue >> (stSize * 8))) throw fail("invalid numeric value.");
+				for (size_t i = 0; i < stSize; i++) {
+					data.push_back(static_cast<BYTE>(ullValue >> ((stSize - 1 - i) * 8))); // Network order
+				}
+				break;
+			}
+			case OptionType::String:
+			{
+				std::string text;
+				std::getline(stream >> std::ws, text);
+				data.assign(text.begin(), text.end());
+				break;
+			}
+			default:
+			{
+				std::string hex;
+				if (!(stream >> hex) || !HexToBytes(hex, data)) throw fail("invalid hexadecimal value.");
+				break;
+			}
+			}
+			if (!IsValidOptionLength(OptionSchemaTable[iCode], data.size())) throw fail("invalid option length.");
+			config.subnets.back().options[static_cast<BYTE>(iCode)] = data;
+		}
+		else {
+			throw fail("unknown keyword.");
+		}
+	}
+
+	return config;
 }
 
 void DHCPServer::SetDiscoverCallback(MessageCallback callback) {
@@ -608,10 +1316,62 @@ void DHCPServer::SetNAKCallback(MessageCallback callback) {
 	MessageCallback_NAK = callback;
 }
 
+void DHCPServer::SetInformCallback(MessageCallback callback) {
+	MessageCallback_Inform = callback;
+}
+
+void DHCPServer::SetSendCallback(SendCallbackFunction callback) {
+	SendCallback = callback;
+}
+
+void DHCPServer::SetClock(ClockFunction clock) {
+	ClockCallback = clock;
+}
+
+void DHCPServer::SetReloadCallback(ReloadCallbackFunction callback) {
+	ReloadCallback = callback;
+}
+
+bool DHCPServer::ProcessRequest(const BYTE *pbData, int iDataSize) {
+	return HandleDHCPClientRequest(pbData, iDataSize, FlightRecorder::Now());
+}
+
+bool DHCPServer::ProcessRequest6(const BYTE *pbData, int iDataSize, std::vector<BYTE> &reply) {
+	if (!upDHCPv6Engine) {
+		reply.clear();
+		return true;
+	}
+	return HandleDHCPv6ClientRequest(pbData, iDataSize, FlightRecorder::Now(), nullptr, reply);
+}
+
+void DHCPServer::SetSlowPacketThreshold(ULONGLONG microseconds) {
+	flightRecorder.SetSlowThreshold(microseconds);
+}
+
+PacketStatistics DHCPServer::GetPacketStatistics() const {
+	return flightRecorder.GetStatistics();
+}
+
+std::string DHCPServer::GetPacketTrace() const {
+	return flightRecorder.GetChromeTrace();
+}
+
+size_t DHCPServer::GetLeaseTableMemoryUsage() const {
+	return leaseTable.MemoryUsage() + (upDHCPv6Engine ? upDHCPv6Engine->GetLeaseTableMemoryUsage() : 0);
+}
+
+ULONGLONG DHCPServer::GetReclaimCount() const {
+	return leaseTable.GetReclaimCount() + (upDHCPv6Engine ? upDHCPv6Engine->GetReclaimCount() : 0);
+}
+
+DHCPServer::DHCPServer() = default;
+
 DHCPServer::DHCPServer(DHCPConfig config) {
 	Init(config);
 }
 
+DHCPServer::~DHCPServer() = default;
+
 bool DHCPServer::Init() {
 	return Init(GetDHCPConfig());
 }
@@ -619,49 +1379,168 @@ bool DHCPServer::Init() {
 bool DHCPServer::Init(DHCPConfig config) {
 	DHCPServer::config = config;
 
-	AddressInUseInformation aiuiServerAddress{};
-	aiuiServerAddress.dwAddrValue = IPtoValue(config.addrInfo.address);
-	aiuiServerAddress.pbClientIdentifier = 0; // Server entry is only entry without a client ID
-	aiuiServerAddress.dwClientIdentifierSize = 0;
-	vAddressesInUse.push_back(aiuiServerAddress);
+	leaseTable.Add(IPtoValue(config.addrInfo.address), nullptr, 0); // Server entry is only entry without a client ID
 
+	// Reserve circuit policy addresses up front and index them by circuit-id so relayed requests need one hash lookup
+	for (auto &&policy : config.circuitPolicies) {
+		const DWORD dwAddrValue = IPtoValue(policy.address);
+		if (policy.circuitId.empty() || (MAX_OPTION_LENGTH < policy.circuitId.size())
+			|| (INVALID_LEASE_HANDLE != leaseTable.FindByAddress(dwAddrValue))) {
+			throw IPAddrException("Invalid circuit policy (empty circuit-id or address already in use).");
+		}
+		const LeaseHandle lhLease = leaseTable.Add(dwAddrValue, policy.circuitId.data(), static_cast<DWORD>(policy.circuitId.size()), false);
+		mapLeaseByCircuit.emplace(HashClientIdentifier(policy.circuitId.data(), policy.circuitId.size()), lhLease);
+	}
+
+	std::atomic_store(&spRuntimeConfig, CompileConfig(config));
+
+	if (0 != config.dhcpv6.prefixLength) {
+		DHCPv6Config dhcpv6Config = config.dhcpv6;
+		if (dhcpv6Config.serverDuid.empty()) {
+			dhcpv6Config.serverDuid = DHCPv6Engine::GetInterfaceDuid(config.addrInfo.index);
+		}
+		upDHCPv6Engine = std::make_unique<DHCPv6Engine>(dhcpv6Config, [this]() { return GetTime(); });
+	}
+
+	if (SendCallback) {
+		// In-memory transport - no socket to open
+		return true;
+	}
+
+#ifdef _WIN32
 	WSADATA wsaData;
-	if (NO_ERROR != WSAStartup(MAKEWORD(1, 1), &wsaData)) {
+	if (NO_ERROR != WSAStartup(MAKEWORD(2, 2), &wsaData)) {
 		throw SocketException("Unable to initialize WinSock.");
 	}
+#endif
+
+	return InitializeDHCPServer() && (!upDHCPv6Engine || InitializeDHCPv6Server());
+}
+
+// True if the entries that only take effect at Init are the same in both configurations
+static bool HaveSameInitOnlySettings(const DHCPServer::DHCPConfig &first, const DHCPServer::DHCPConfig &second) {
+	auto dhcpv6Key = [](const DHCPServer::DHCPv6Config &dhcpv6) {
+		return std::tie(dhcpv6.prefix, dhcpv6.prefixLength, dhcpv6.preferredLifetime, dhcpv6.validLifetime, dhcpv6.dnsServers, dhcpv6.serverDuid);
+	};
+	return (dhcpv6Key(first.dhcpv6) == dhcpv6Key(second.dhcpv6))
+		&& std::equal(first.circuitPolicies.begin(), first.circuitPolicies.end(), second.circuitPolicies.begin(), second.circuitPolicies.end(),
+			[](const DHCPServer::CircuitPolicy &a, const DHCPServer::CircuitPolicy &b) { return (a.circuitId == b.circuitId) && (a.address == b.address); });
+}
+
+bool DHCPServer::Reload(DHCPConfig config) {
+	std::lock_guard<std::mutex> lock(mConfig);
+
+	// The bound interface, the circuit reservations in the lease table and the DHCPv6 engine stay as they were at Init
+	const bool bInitOnlyUnchanged = HaveSameInitOnlySettings(config, DHCPServer::config);
+	config.addrInfo = DHCPServer::config.addrInfo;
+	config.circuitPolicies = DHCPServer::config.circuitPolicies;
+	config.dhcpv6 = DHCPServer::config.dhcpv6;
+
+	// Compile first so that an invalid configuration leaves the running one untouched
+	auto runtimeConfig = CompileConfig(config);
+	DHCPServer::config.minAddr = config.minAddr;
+	DHCPServer::config.maxAddr = config.maxAddr;
+	DHCPServer::config.subnets = std::move(config.subnets);
+	DHCPServer::config.reservations = std::move(config.reservations);
+	std::atomic_store(&spRuntimeConfig, runtimeConfig);
+	return bInitOnlyUnchanged;
+}
 
-	return InitializeDHCPServer();
+void DHCPServer::SetConfigFile(std::string path) {
+	std::lock_guard<std::mutex> lock(mConfig);
+	configFile = path;
+}
+
+void DHCPServer::RequestReload() {
+	bReloadRequested = true;
 }
 
 void DHCPServer::Start() {
-	assert(ReadDHCPClientRequests());
+	[[maybe_unused]] const bool bResult = ReadDHCPClientRequests();
+	assert(bResult);
+}
+
+void DHCPServer::StartControl(u_short port) {
+	sControlSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (INVALID_SOCKET == sControlSocket) {
+		throw SocketException("Unable to open control socket.");
+	}
+
+#ifndef _WIN32
+	// Let a restarted server bind while connections from the previous one are in TIME_WAIT (WinSock allows this by default)
+	int iReuseAddressOption = TRUE;
+	setsockopt(sControlSocket, SOL_SOCKET, SO_REUSEADDR, (char *)(&iReuseAddressOption), sizeof(iReuseAddressOption));
+#endif
+
+	// Loopback only - the control socket is not authenticated
+	SOCKADDR_IN saControlAddress{};
+	saControlAddress.sin_family = AF_INET;
+	saControlAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	saControlAddress.sin_port = htons(port);
+	if (SOCKET_ERROR == ::bind(sControlSocket, (SOCKADDR *)(&saControlAddress), sizeof(saControlAddress))
+		|| SOCKET_ERROR == listen(sControlSocket, SOMAXCONN)) {
+		closesocket(sControlSocket);
+		sControlSocket = INVALID_SOCKET;
+		throw SocketException("Unable to bind to control socket.");
+	}
+
+#ifdef _WIN32
+	tControlThread = std::thread(&DHCPServer::ReadControlRequests, this);
+#else
+	// Signals must interrupt the request thread, so the control thread starts with every signal blocked
+	sigset_t ssBlocked, ssPrevious;
+	sigfillset(&ssBlocked);
+	pthread_sigmask(SIG_BLOCK, &ssBlocked, &ssPrevious);
+	tControlThread = std::thread(&DHCPServer::ReadControlRequests, this);
+	pthread_sigmask(SIG_SETMASK, &ssPrevious, nullptr);
+#endif
 }
 
 void DHCPServer::Close() {
 	if (INVALID_SOCKET != sServerSocket) {
-		assert(NO_ERROR == closesocket(sServerSocket));
+		[[maybe_unused]] const int iResult = closesocket(sServerSocket);
+		assert(NO_ERROR == iResult);
 		sServerSocket = INVALID_SOCKET;
 	}
+	if (INVALID_SOCKET != sServerSocket6) {
+		[[maybe_unused]] const int iResult = closesocket(sServerSocket6);
+		assert(NO_ERROR == iResult);
+		sServerSocket6 = INVALID_SOCKET;
+	}
+	if (INVALID_SOCKET != sControlSocket) {
+		[[maybe_unused]] const int iResult = closesocket(sControlSocket);
+		assert(NO_ERROR == iResult);
+		sControlSocket = INVALID_SOCKET;
+	}
 }
 
 bool DHCPServer::Cleanup() {
-	if (!WSACleanup()) return false;
-
-	for (size_t i = 0; i < vAddressesInUse.size(); i++) {
-		AddressInUseInformation aiuiServerAddress{};
-		aiuiServerAddress = vAddressesInUse.at(i);
-		if (aiuiServerAddress.pbClientIdentifier != 0) {
-			LocalFree(aiuiServerAddress.pbClientIdentifier);
-		}
+	// Start() can also end with an exception, leaving the control thread blocked in accept()
+	Close();
+	if (tControlThread.joinable()) {
+		tControlThread.join();
+	}
+	if (SendCallback) {
+		// In-memory transport never started WinSock
+		return true;
 	}
 
+#ifdef _WIN32
+	return NO_ERROR == WSACleanup();
+#else
 	return true;
+#endif
 }
 
 bool DHCPServer::SetServerName(std::string name) {
 	if (name.size() > 64)
 		return false;
 
+	std::lock_guard<std::mutex> lock(mConfig);
 	serverName = name;
+	if (std::atomic_load(&spRuntimeConfig)) {
+		// Re-encode the DHCPINFORM reply templates with the new name
+		std::atomic_store(&spRuntimeConfig, CompileConfig(config));
+	}
 	return true;
 }
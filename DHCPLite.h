@@ -2,11 +2,19 @@
 
 #include <map>
 #include <array>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <functional>
-#include <windows.h>
-#include <winsock.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "DHCPPlatform.h"
+#include "DHCPMessage.h"
+#include "DHCPTrace.h"
+#include "DHCPLeaseTable.h"
+#include "DHCPAllocator.h"
 
 namespace DHCPLite {
 	// Maximum size of a UDP datagram (see RFC 768)
@@ -15,118 +23,159 @@ namespace DHCPLite {
 	constexpr auto DHCP_SERVER_PORT = 67;
 	// DHCP constants (see RFC 2131 section 4.1)
 	constexpr auto DHCP_CLIENT_PORT = 68;
+	// DHCPv6 constants (see RFC 8415 section 7.2)
+	constexpr auto DHCPV6_SERVER_PORT = 547;
+	// DHCPv6 constants (see RFC 8415 section 7.2)
+	constexpr auto DHCPV6_CLIENT_PORT = 546;
 	// Broadcast bit for flags field (RFC 2131 section 2)
 	constexpr auto BROADCAST_FLAG = 0x80;
 	// For display of host name information
 	constexpr auto MAX_HOSTNAME_LENGTH = 256;
+	// Default loopback TCP port for lease queries
+	constexpr auto DHCP_CONTROL_PORT = 6767;
+	// Time a control connection gets to send its command (and to take each part of the response)
+	constexpr auto CONTROL_TIMEOUT_MILLISECONDS = 2000;
 
-	class DHCPMessage {
+	// Immutable copy of the lease table, safe to query from any thread while the server runs
+	class LeaseSnapshot {
 	public:
-		enum MessageTypes {
-			MsgType_DISCOVER = 1,
-			MsgType_OFFER = 2,
-			MsgType_REQUEST = 3,
-			MsgType_DECLINE = 4,
-			MsgType_ACK = 5,
-			MsgType_NAK = 6,
-			MsgType_RELEASE = 7,
-			MsgType_INFORM = 8,
-		};
-		enum MessageOpValues { // RFC 2131 section 2
-			MsgOp_BOOT_REQUEST = 1,
-			MsgOp_BOOT_REPLY = 2,
-		};
-		enum MessageOptionValues { // RFC 2132 section 9.6
-			MsgOption_PAD = 0,
-			MsgOption_SUBNET_MASK = 1,
-			MsgOption_HOSTNAME = 12,
-			MsgOption_REQUESTED_ADDRESS = 50,
-			MsgOption_ADDRESS_LEASETIME = 51,
-			MsgOption_MESSAGE_TYPE = 53,
-			MsgOption_SERVER_IDENTIFIER = 54,
-			MsgOption_CLIENT_IDENTIFIER = 61,
-			MsgOption_END = 255,
+		struct LeaseInformation {
+			DWORD address; // Network order
+			std::vector<BYTE> clientIdentifier; // Empty for the server's own address
+			ULONGLONG expireTime; // Server clock seconds; LEASE_NEVER_EXPIRES until acknowledged
+			bool circuit; // clientIdentifier is the relay agent circuit-id the address is reserved for
 		};
 
-	private:
-		std::map<BYTE, std::vector<BYTE>> optionList;
+		LeaseSnapshot(ULONGLONG generation, std::vector<LeaseInformation> leases);
 
-		// Get the options and save it into optionList
-		size_t SetOptionList(std::vector<BYTE> options);
+		// Lease table generation this snapshot was taken at
+		ULONGLONG GetGeneration() const;
 
-	public:
-		struct MessageBody {		// RFC 2131 section 2
-			BYTE op;				// 0: Message opcode/type
-			BYTE htype;			  	// 1: Hardware addr type (net/if_types.h)
-			BYTE hlen;			  	// 2: Hardware addr length
-			BYTE hops;			  	// 3: Number of relay agent hops from client
-			DWORD xid;			  	// 4: Transaction ID
-			WORD secs;			  	// 8: Seconds since client started looking
-			WORD flags;			  	// 10: Flag bits
-			DWORD ciaddr;		  	// 12: Client IP address (if already in use)
-			DWORD yiaddr;		  	// 16: Client IP address
-			DWORD siaddr;		  	// 20: IP address of next server to talk to
-			DWORD giaddr;		  	// 24: DHCP relay agent IP address
-			BYTE chaddr[16];	  	// 28: Client hardware address
-			BYTE sname[64];		  	// 44: Server name
-			BYTE file[128];		  	// 108: Boot filename
-			DWORD magicCookie;		// 236: Optional parameters (First is MagicCookie)
-		} body;
-
-		DHCPMessage();
-		DHCPMessage(std::vector<BYTE> data);
-
-		std::vector<BYTE> GetData();
-		void SetData(std::vector<BYTE> data);
-
-		std::vector<BYTE> GetOptionRaw(MessageOptionValues option);
-		template <class T> T GetOption(MessageOptionValues option);
-		void SetOptionRaw(MessageOptionValues option, std::vector<BYTE> data);
-		template <class T> void SetOption(MessageOptionValues option, T data);
-		void SetOption(MessageOptionValues option);
-
-		static std::vector<BYTE> PByteToVByte(const BYTE *data, int size);
-	};
+		// All leases in ascending address order
+		const std::vector<LeaseInformation> &GetLeases() const;
+
+		const LeaseInformation *FindByAddress(DWORD address) const;
+		// Circuit reservations are not client identifiers and are never returned
+		const LeaseInformation *FindByClientIdentifier(const std::vector<BYTE> &clientIdentifier) const;
 
-	class DHCPServer {
 	private:
-		struct AddressInUseInformation {
-			DWORD dwAddrValue;
-			BYTE *pbClientIdentifier;
-			DWORD dwClientIdentifierSize;
-			// SYSTEMTIME stExpireTime; // If lease timeouts are needed
-		};
-		typedef std::vector<AddressInUseInformation> VectorAddressInUseInformation;
+		ULONGLONG generation;
+		std::vector<LeaseInformation> leases;
+		std::vector<std::pair<ULONGLONG, size_t>> clientIndex; // Sorted by client identifier hash
+	};
+
+	typedef std::array<BYTE, 16> IPv6Address; // Network order
 
-		typedef std::function<bool(const AddressInUseInformation &raiui)> FindIndexOfFilter;
+	class DHCPv6Engine;
+
+	class DHCPServer {
+	public:
+		// Stable index of a lease in the lease table
+		typedef LeaseTable<DWORD>::LeaseHandle LeaseHandle;
+		static constexpr LeaseHandle INVALID_LEASE_HANDLE = LeaseTable<DWORD>::INVALID_LEASE_HANDLE;
 
 	private:
-		SOCKET sServerSocket = INVALID_SOCKET; // Global to allow ConsoleCtrlHandlerRoutine access to it
-		VectorAddressInUseInformation vAddressesInUse;
+		// Atomic because Close() runs on another thread (or in a signal handler) while requests are read;
+		// call ::bind on them, as argument-dependent lookup on std::atomic would otherwise find std::bind
+		std::atomic<SOCKET> sServerSocket{ INVALID_SOCKET }; // Global to allow ConsoleCtrlHandlerRoutine access to it
+		std::atomic<SOCKET> sServerSocket6{ INVALID_SOCKET }; // DHCPv6, only when enabled
+		std::atomic<SOCKET> sControlSocket{ INVALID_SOCKET };
+		std::atomic<bool> bReloadRequested{ false }; // Set by RequestReload, possibly from a signal handler
+		std::thread tControlThread;
+		bool bUnicastToHardwareAddress = true; // Cleared if the ARP cache cannot be updated (e.g. not elevated)
+
+		LeaseTable<DWORD> leaseTable; // Keyed by address value
+		AddressAllocator addressAllocator{ leaseTable };
+		std::unordered_multimap<ULONGLONG, LeaseHandle> mapLeaseByCircuit; // Keyed by circuit-id hash, built at Init
+		std::mutex mLeaseSnapshot;
+		std::shared_ptr<const LeaseSnapshot> spLeaseSnapshot;
+
 		char pcsServerHostName[MAX_HOSTNAME_LENGTH]{};
 		std::string serverName = "DHCPLite DHCP Server";
+		std::vector<BYTE> vInformReplyBuffer;
+
+		LeaseHandle FindLeaseByCircuit(const std::vector<BYTE> &circuitId);
 
-		int FindIndexOf(const VectorAddressInUseInformation *const pvAddressesInUse, FindIndexOfFilter pFilter);
+		ULONGLONG GetTime();
 
 		bool InitializeDHCPServer();
+		bool InitializeDHCPv6Server();
 
-		void ProcessDHCPClientRequest(const BYTE *const pbData, const int iDataSize);
+		void ProcessDHCPInformRequest(const DHCPMessage &requestMessage, char *pcsClientHostName, PacketTrace &trace);
+
+		void ProcessDHCPClientRequest(const BYTE *const pbData, const int iDataSize, PacketTrace &trace);
+		// Process one request, recording its trace; returns false if it was dropped
+		bool HandleDHCPClientRequest(const BYTE *pbData, int iDataSize, ULONGLONG ullReceiveTime);
+		// Same for DHCPv6; the reply is sent to psaClientAddress if given, otherwise left in reply
+		bool HandleDHCPv6ClientRequest(const BYTE *pbData, int iDataSize, ULONGLONG ullReceiveTime, const SOCKADDR_IN6 *psaClientAddress, std::vector<BYTE> &reply);
+
+		void SendDHCPReply(const BYTE *pbData, int iDataSize, DWORD ulAddr);
+
+		bool SetClientHardwareAddress(DWORD dwClientAddr, const BYTE *pbHardwareAddr, BYTE bHardwareAddrSize);
 
 		bool ReadDHCPClientRequests();
 
+		// Read the configuration file again and apply it; returns the outcome as one line
+		std::string ReloadConfigFile();
+
+		std::string ProcessControlRequest(const std::string &request);
+
+		void ReadControlRequests();
+
 	public:
 		struct IPAddrInfo {
 			DWORD address;
 			DWORD mask;
+			DWORD index; // Interface index (0 if unknown)
+		};
+
+		// Fixed address for every client behind a relay agent circuit (RFC 3046 circuit-id)
+		struct CircuitPolicy {
+			std::vector<BYTE> circuitId;
+			DWORD address;
+		};
+
+		// Addresses served to one subnet (directly attached or behind a relay agent); addresses in network order
+		struct SubnetConfig {
+			DWORD network;
+			DWORD mask;
+			std::vector<std::pair<DWORD, DWORD>> pools; // Inclusive ranges
+			std::vector<std::pair<DWORD, DWORD>> exclusions; // Inclusive ranges removed from pools
+			DWORD leaseTime = 60 * 60; // Seconds
+			DWORD idleReclaimTime = 0; // Seconds without a request before an unexpired binding may be reclaimed from a full pool (0 = never)
+			std::map<BYTE, std::vector<BYTE>> options; // Additional options, already encoded
+		};
+
+		// Fixed address for a client hardware address
+		struct Reservation {
+			std::vector<BYTE> hardwareAddress;
+			DWORD address;
+		};
+
+		// DHCPv6 address assignment from one prefix; a prefixLength of 0 leaves DHCPv6 off
+		struct DHCPv6Config {
+			IPv6Address prefix;
+			BYTE prefixLength = 0;
+			DWORD preferredLifetime = 60 * 60; // Seconds
+			DWORD validLifetime = 2 * 60 * 60; // Seconds
+			std::vector<IPv6Address> dnsServers;
+			std::vector<BYTE> serverDuid; // Empty for a DUID-LL built from the interface's hardware address
 		};
 
 		struct DHCPConfig {
 			IPAddrInfo addrInfo;
-			DWORD minAddr;
-			DWORD maxAddr;
+			DWORD minAddr; // Used when subnets is empty
+			DWORD maxAddr; // Used when subnets is empty
+			std::vector<CircuitPolicy> circuitPolicies; // Applied at Init only
+			std::vector<SubnetConfig> subnets;
+			std::vector<Reservation> reservations;
+			DHCPv6Config dhcpv6; // Applied at Init only
 		};
 
 		typedef std::function<void(char *clientHostName, DWORD offerAddr)> MessageCallback;
+		typedef std::function<void(const BYTE *pbData, int iDataSize, DWORD dwAddr)> SendCallbackFunction;
+		typedef std::function<ULONGLONG()> ClockFunction;
+		typedef std::function<void(const std::string &result)> ReloadCallbackFunction;
 
 		static DWORD IPtoValue(DWORD ip);
 		static DWORD ValuetoIP(DWORD value);
@@ -135,13 +184,26 @@ namespace DHCPLite {
 
 		static std::vector<IPAddrInfo> GetIPAddrInfoList();
 		static DHCPConfig GetDHCPConfig();
+		// Read subnets, pools, exclusions, lease times, options and reservations from a file on top of config
+		static DHCPConfig LoadDHCPConfig(const std::string &path, DHCPConfig config);
 
 	private:
 		DHCPConfig config{};
+		std::string configFile;
+		std::mutex mConfig; // Serializes reloads
+		std::shared_ptr<const RuntimeConfig> spRuntimeConfig; // Accessed with std::atomic_load/atomic_store
+
+		std::shared_ptr<const RuntimeConfig> CompileConfig(const DHCPConfig &config) const;
 
 		MessageCallback MessageCallback_Discover;
 		MessageCallback MessageCallback_ACK;
 		MessageCallback MessageCallback_NAK;
+		MessageCallback MessageCallback_Inform;
+		SendCallbackFunction SendCallback;
+		ClockFunction ClockCallback;
+		ReloadCallbackFunction ReloadCallback;
+		FlightRecorder flightRecorder;
+		std::unique_ptr<DHCPv6Engine> upDHCPv6Engine;
 
 	public:
 		// Set Discover Message Callback
@@ -156,43 +218,76 @@ namespace DHCPLite {
 		// Callback Parameter: pcsClientHostName, dwClientPreviousOfferAddr
 		void SetNAKCallback(MessageCallback callback);
 
-		DHCPServer() {}
+		// Set Inform Message Callback
+		// Callback Parameter: pcsClientHostName, dwClientAddr
+		void SetInformCallback(MessageCallback callback);
+
+		// Set In-Memory Transport (no socket is opened by Init when set)
+		// Callback Parameter: pbData, iDataSize, dwAddr (destination, network order)
+		void SetSendCallback(SendCallbackFunction callback);
+
+		// Set Clock used for lease times, in seconds (defaults to system uptime)
+		void SetClock(ClockFunction clock);
+
+		// Set Reload Callback, called on the request thread after a reload asked for with RequestReload
+		// Callback Parameter: result (the same line the control socket "reload" command answers with)
+		void SetReloadCallback(ReloadCallbackFunction callback);
+
+		// Handle one request datagram as if it had been received on the server socket
+		// Returns false if the request was dropped (malformed or unserviceable)
+		bool ProcessRequest(const BYTE *pbData, int iDataSize);
+
+		// Handle one DHCPv6 request datagram; the reply for its sender is returned in reply (empty if none)
+		// Returns false if the request was dropped
+		bool ProcessRequest6(const BYTE *pbData, int iDataSize, std::vector<BYTE> &reply);
+
+		// Packets taking longer than this from receive to send are kept in full for GetPacketTrace
+		void SetSlowPacketThreshold(ULONGLONG microseconds);
+
+		// Packet counters summed over all processors
+		PacketStatistics GetPacketStatistics() const;
+
+		// Recent, slow and dropped packets as Chrome trace event JSON
+		std::string GetPacketTrace() const;
+
+		// Bytes allocated for the DHCPv4 and DHCPv6 lease tables
+		size_t GetLeaseTableMemoryUsage() const;
+
+		// Stale bindings taken over for new clients because their pool was full (DHCPv4 and DHCPv6)
+		ULONGLONG GetReclaimCount() const;
+
+		DHCPServer();
 		DHCPServer(DHCPConfig config);
+		~DHCPServer();
 
 		bool Init();
 		bool Init(DHCPConfig config);
 
 		void Start();
 
-		void Close();
+		// Serve lease queries on a loopback TCP port from a background thread
+		// Commands: "leases", "lease <address>", "client <hex client identifier>", "leases6", "reload", "stats", "trace"
+		void StartControl(u_short port = DHCP_CONTROL_PORT);
 
-		bool Cleanup();
+		// Replace subnets and reservations while running; existing leases are kept. Circuit policies and
+		// DHCPv6 settings apply at Init only - returns false if config changes them, as those changes are ignored.
+		bool Reload(DHCPConfig config);
 
-		bool SetServerName(std::string name);
-	};
+		// File read again by the control socket "reload" command
+		void SetConfigFile(std::string path);
 
-	class DHCPException : public std::exception {
-	public:
-		DHCPException(const char *Message) : exception(Message, 1) {}
-	};
+		// Have the request thread read the configuration file again before its next request, like the control
+		// socket "reload" command. Only sets a flag, so it is safe to call from a signal handler (e.g. SIGHUP).
+		void RequestReload();
 
-	class MessageException : public DHCPException {
-	public:
-		MessageException(const char *Message) : DHCPException(Message) {}
-	};
+		// Snapshot of the current leases; cheap to call repeatedly while the table is unchanged. Otherwise the
+		// table is copied under its lock, which stalls lease changes on the request thread for the copy (O(leases)).
+		std::shared_ptr<const LeaseSnapshot> GetLeaseSnapshot();
 
-	class IPAddrException : public DHCPException {
-	public:
-		IPAddrException(const char *Message) : DHCPException(Message) {}
-	};
+		void Close();
 
-	class SocketException : public DHCPException {
-	public:
-		SocketException(const char *Message) : DHCPException(Message) {}
-	};
+		bool Cleanup();
 
-	class RequestException : public DHCPException {
-	public:
-		RequestException(const char *Message) : DHCPException(Message) {}
+		bool SetServerName(std::string name);
 	};
 }
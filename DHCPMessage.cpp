@@ -0,0 +1,188 @@
+#include "DHCPMessage.h"
+#include <algorithm>
+
+using namespace DHCPLite;
+
+size_t DHCPMessage::ParseOptionArea(const BYTE *pbData, size_t size, std::vector<BYTE> &concatenated) {
+	size_t count = 0;
+	for (size_t i = 0; i < size; i++) { // RFC 2132
+		switch (pbData[i]) {
+		case MsgOption_PAD:
+			continue;
+			break;
+		case MsgOption_END:
+			optionList[pbData[i]] = std::vector<BYTE>{}; // MsgOption_END
+			return count;
+			break;
+		default:
+		{
+			if (i + 1 >= size)
+				throw MessageException("Invalid DHCP message option (not enough room for required length byte).");
+
+			BYTE optionLen = pbData[i + 1];
+			if (i + 2 + optionLen > size)
+				throw MessageException("Invalid DHCP message option (size exceeds actual size).");
+
+			const BYTE bCode = pbData[i];
+			const BYTE *const pbOptionData = pbData + i + 2;
+			const OptionSchema &schema = OptionSchemaTable[bCode];
+			if (schema.concatenate) {
+				// Repeated instances of an option are concatenated in order (RFC 3396 section 7)
+				auto itOption = optionList.try_emplace(bCode);
+				if (itOption.second) {
+					concatenated.push_back(bCode);
+				}
+				itOption.first->second.insert(itOption.first->second.end(), pbOptionData, pbOptionData + optionLen);
+			}
+			else if (IsValidOptionLength(schema, optionLen)) {
+				// A repeated option that cannot be split keeps its first instance
+				optionList.emplace(bCode, std::vector<BYTE>(pbOptionData, pbOptionData + optionLen));
+			}
+			// Malformed options are dropped so that a missing required option is reported by the caller
+
+			i += 1; // lenght bit
+			i += optionLen; // data bit
+			count++;
+			break;
+		}
+		}
+	}
+	return count;
+}
+
+size_t DHCPMessage::SetOptionList(std::vector<BYTE> options) {
+	std::vector<BYTE> concatenated;
+	size_t size = ParseOptionArea(options.data(), options.size(), concatenated);
+
+	// Overloaded file and sname fields follow the options field (RFC 3396 section 6)
+	auto overload = GetOption<MsgOption_OPTION_OVERLOAD>();
+	if (overload & MsgOverload_FILE) {
+		optionList.erase(MsgOption_END);
+		size += ParseOptionArea(body.file, sizeof(body.file), concatenated);
+	}
+	if (overload & MsgOverload_SNAME) {
+		optionList.erase(MsgOption_END);
+		size += ParseOptionArea(body.sname, sizeof(body.sname), concatenated);
+	}
+
+	ValidateConcatenatedOptions(concatenated);
+	return size;
+}
+
+static WORD GetOptionItemSize(OptionType type) {
+	return (OptionType::AddressList == type) ? sizeof(DWORD) : 1;
+}
+
+bool DHCPLite::IsValidOptionLength(const OptionSchema &schema, size_t size) {
+	return (schema.minLength <= size) && (size <= schema.maxLength)
+		&& (!schema.repeatable || (0 == size % GetOptionItemSize(schema.type)));
+}
+
+void DHCPMessage::ValidateConcatenatedOptions(const std::vector<BYTE> &concatenated) {
+	for (auto &&code : concatenated) {
+		// Malformed options are dropped so that a missing required option is reported by the caller
+		auto it = optionList.find(code);
+		if (!IsValidOptionLength(OptionSchemaTable[code], it->second.size())) {
+			optionList.erase(it);
+		}
+	}
+}
+
+DHCPMessage::DHCPMessage() : body() {
+	BYTE *pBody = reinterpret_cast<BYTE *>(&body);
+	std::fill_n(pBody, sizeof(MessageBody), 0);
+}
+
+DHCPMessage::DHCPMessage(std::vector<BYTE> data) {
+	SetData(data);
+}
+
+std::vector<BYTE> DHCPMessage::GetData() {
+	std::vector<BYTE> data(sizeof(MessageBody));
+	BYTE *pBody = reinterpret_cast<BYTE *>(&body);
+	std::copy_n(pBody, sizeof(MessageBody), data.begin());
+
+	for (auto &&option : optionList) {
+		if (OptionType::Empty == OptionSchemaTable[option.first].type) {
+			data.push_back(option.first);
+			continue;
+		}
+
+		// Values longer than one option are split into consecutive instances (RFC 3396 section 5); only
+		// concatenable options can be that long
+		const std::vector<BYTE> &optionData = option.second;
+		size_t offset = 0;
+		do {
+			const size_t chunkSize = min(optionData.size() - offset, static_cast<size_t>(MAX_OPTION_LENGTH));
+			data.push_back(option.first);
+			data.push_back(static_cast<BYTE>(chunkSize));
+			data.insert(data.end(), optionData.begin() + offset, optionData.begin() + offset + chunkSize);
+			offset += chunkSize;
+		} while (offset < optionData.size());
+	}
+
+	return data;
+}
+
+void DHCPMessage::SetData(std::vector<BYTE> data) {
+	// Take into account mandatory DHCP magic cookie values in options array (RFC 2131 section 3)
+	if (data.size() < sizeof(MessageBody))
+		throw MessageException("Invalid DHCP message (failed initial checks).");
+
+	BYTE *pBody = reinterpret_cast<BYTE *>(&body);
+	std::copy_n(data.begin(), sizeof(MessageBody), pBody);
+
+	std::vector<BYTE> options(data.size() - sizeof(MessageBody));
+	options.assign(data.begin() + sizeof(MessageBody), data.end());
+	SetOptionList(options);
+}
+
+std::vector<BYTE> DHCPMessage::GetOptionRaw(MessageOptionValues option) const {
+	auto it = optionList.find(option);
+	if (it != optionList.end()) {
+		return it->second;
+	}
+
+	return std::vector<BYTE>{};
+}
+
+void DHCPMessage::SetOptionRaw(MessageOptionValues option, std::vector<BYTE> data) {
+	if (!IsValidOptionLength(OptionSchemaTable[option], data.size()))
+		throw MessageException("Invalid DHCP message option (size does not match option schema).");
+
+	optionList[option] = data;
+}
+
+void DHCPMessage::SetOption(MessageOptionValues option) {
+	optionList[option] = std::vector<BYTE>{};
+}
+
+DHCPMessage::RelayAgentInformation DHCPMessage::GetRelayAgentInformation() const {
+	RelayAgentInformation information;
+	auto raw = GetOptionRaw(MsgOption_RELAY_AGENT_INFORMATION);
+	for (size_t i = 0; i + 1 < raw.size();) {
+		const BYTE subOptionLen = raw[i + 1];
+		if (i + 2 + subOptionLen > raw.size()) break;
+
+		auto itData = raw.begin() + i + 2;
+		switch (raw[i]) {
+		case RelaySubOption_CIRCUIT_ID:
+			information.circuitId.assign(itData, itData + subOptionLen);
+			break;
+		case RelaySubOption_REMOTE_ID:
+			information.remoteId.assign(itData, itData + subOptionLen);
+			break;
+		default:
+			// Other sub-options are only echoed
+			break;
+		}
+		i += 2 + subOptionLen;
+	}
+	return information;
+}
+
+std::vector<BYTE> DHCPMessage::PByteToVByte(const BYTE *data, int size) {
+	std::vector<BYTE> bytes(size);
+	std::copy_n(data, size, bytes.begin());
+	return bytes;
+}
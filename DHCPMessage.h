@@ -0,0 +1,253 @@
+#pragma once
+
+#include <map>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <type_traits>
+#include "DHCPPlatform.h"
+#include "DHCPException.h"
+
+namespace DHCPLite {
+	// Maximum length of a single encoded option (RFC 2132 section 2)
+	constexpr auto MAX_OPTION_LENGTH = 255;
+	// First four octets of the options field (RFC 2131 section 3)
+	constexpr BYTE MAGIC_COOKIE[4]{ 0x63, 0x82, 0x53, 0x63 };
+
+	// Wire representation of an option value
+	enum class OptionType : BYTE {
+		Empty,			// No length or data (PAD, END)
+		Byte,			// 1-octet value
+		Word,			// 2-octet value (network order)
+		DWord,			// 4-octet value (network order)
+		Address,		// IPv4 address (network order)
+		AddressList,	// One or more IPv4 addresses
+		String,			// NVT ASCII text
+		Binary,			// Opaque octets
+	};
+
+	// Static description of a DHCP option used to validate and encode it
+	struct OptionSchema {
+		BYTE code;
+		OptionType type;
+		WORD minLength;
+		WORD maxLength;
+		bool repeatable;	// Value is a list of fixed size items
+		bool concatenate;	// Value may be split across several options (RFC 3396)
+	};
+
+	class DHCPMessage {
+	public:
+		enum MessageTypes {
+			MsgType_DISCOVER = 1,
+			MsgType_OFFER = 2,
+			MsgType_REQUEST = 3,
+			MsgType_DECLINE = 4,
+			MsgType_ACK = 5,
+			MsgType_NAK = 6,
+			MsgType_RELEASE = 7,
+			MsgType_INFORM = 8,
+		};
+		enum MessageOpValues { // RFC 2131 section 2
+			MsgOp_BOOT_REQUEST = 1,
+			MsgOp_BOOT_REPLY = 2,
+		};
+		enum MessageOptionValues { // RFC 2132
+			MsgOption_PAD = 0,
+			MsgOption_SUBNET_MASK = 1,
+			MsgOption_ROUTER = 3,
+			MsgOption_DOMAIN_NAME_SERVER = 6,
+			MsgOption_HOSTNAME = 12,
+			MsgOption_DOMAIN_NAME = 15,
+			MsgOption_BROADCAST_ADDRESS = 28,
+			MsgOption_NTP_SERVERS = 42,
+			MsgOption_VENDOR_SPECIFIC = 43,
+			MsgOption_REQUESTED_ADDRESS = 50,
+			MsgOption_ADDRESS_LEASETIME = 51,
+			MsgOption_OPTION_OVERLOAD = 52,
+			MsgOption_MESSAGE_TYPE = 53,
+			MsgOption_SERVER_IDENTIFIER = 54,
+			MsgOption_PARAMETER_REQUEST_LIST = 55,
+			MsgOption_MESSAGE = 56,
+			MsgOption_MAX_MESSAGE_SIZE = 57,
+			MsgOption_RENEWAL_TIME = 58,
+			MsgOption_REBINDING_TIME = 59,
+			MsgOption_VENDOR_CLASS_IDENTIFIER = 60,
+			MsgOption_CLIENT_IDENTIFIER = 61,
+			MsgOption_RELAY_AGENT_INFORMATION = 82,
+			MsgOption_DOMAIN_SEARCH = 119,
+			MsgOption_CLASSLESS_STATIC_ROUTE = 121,
+			MsgOption_END = 255,
+		};
+		enum OptionOverloadValues { // RFC 2132 section 9.3
+			MsgOverload_FILE = 1,
+			MsgOverload_SNAME = 2,
+		};
+		enum RelayAgentSubOptionValues { // RFC 3046 section 2.0
+			RelaySubOption_CIRCUIT_ID = 1,
+			RelaySubOption_REMOTE_ID = 2,
+		};
+
+		// Options with a known layout; any other code is treated as opaque concatenable binary data
+		static constexpr OptionSchema OptionSchemaList[] = {
+			// { code, type, minLength, maxLength, repeatable, concatenate }
+			{ MsgOption_PAD,					OptionType::Empty,			0,	0,		false,		false },
+			{ MsgOption_SUBNET_MASK,			OptionType::Address,		4,	4,		false,		false },
+			{ MsgOption_ROUTER,					OptionType::AddressList,	4,	1020,	true,		true },
+			{ MsgOption_DOMAIN_NAME_SERVER,		OptionType::AddressList,	4,	1020,	true,		true },
+			{ MsgOption_HOSTNAME,				OptionType::String,			1,	255,	false,		false },
+			{ MsgOption_DOMAIN_NAME,			OptionType::String,			1,	255,	false,		false },
+			{ MsgOption_BROADCAST_ADDRESS,		OptionType::Address,		4,	4,		false,		false },
+			{ MsgOption_NTP_SERVERS,			OptionType::AddressList,	4,	1020,	true,		true },
+			{ MsgOption_VENDOR_SPECIFIC,		OptionType::Binary,			1,	1020,	false,		true },
+			{ MsgOption_REQUESTED_ADDRESS,		OptionType::Address,		4,	4,		false,		false },
+			{ MsgOption_ADDRESS_LEASETIME,		OptionType::DWord,			4,	4,		false,		false },
+			{ MsgOption_OPTION_OVERLOAD,		OptionType::Byte,			1,	1,		false,		false },
+			{ MsgOption_MESSAGE_TYPE,			OptionType::Byte,			1,	1,		false,		false },
+			{ MsgOption_SERVER_IDENTIFIER,		OptionType::Address,		4,	4,		false,		false },
+			{ MsgOption_PARAMETER_REQUEST_LIST,	OptionType::Binary,			1,	1020,	true,		true },
+			{ MsgOption_MESSAGE,				OptionType::String,			1,	255,	false,		false },
+			{ MsgOption_MAX_MESSAGE_SIZE,		OptionType::Word,			2,	2,		false,		false },
+			{ MsgOption_RENEWAL_TIME,			OptionType::DWord,			4,	4,		false,		false },
+			{ MsgOption_REBINDING_TIME,			OptionType::DWord,			4,	4,		false,		false },
+			{ MsgOption_VENDOR_CLASS_IDENTIFIER,OptionType::Binary,			1,	255,	false,		false },
+			{ MsgOption_CLIENT_IDENTIFIER,		OptionType::Binary,			2,	255,	false,		false },
+			{ MsgOption_RELAY_AGENT_INFORMATION,OptionType::Binary,			2,	255,	false,		false },
+			{ MsgOption_DOMAIN_SEARCH,			OptionType::Binary,			1,	1020,	false,		true },
+			{ MsgOption_CLASSLESS_STATIC_ROUTE,	OptionType::Binary,			5,	1020,	false,		true },
+			{ MsgOption_END,					OptionType::Empty,			0,	0,		false,		false },
+		};
+
+	private:
+		std::map<BYTE, std::vector<BYTE>> optionList;
+
+		// Parse an option area into optionList in a single pass. Options that cannot be split are checked
+		// against their schema as they are read and keep their first instance; instances of a concatenable
+		// option are joined (RFC 3396) and its code added to concatenated, as only the joined value can be checked.
+		size_t ParseOptionArea(const BYTE *pbData, size_t size, std::vector<BYTE> &concatenated);
+		// Get the options and save it into optionList
+		size_t SetOptionList(std::vector<BYTE> options);
+		// Check the joined concatenable options against their schema entries
+		void ValidateConcatenatedOptions(const std::vector<BYTE> &concatenated);
+
+	public:
+		struct MessageBody {		// RFC 2131 section 2
+			BYTE op;				// 0: Message opcode/type
+			BYTE htype;			  	// 1: Hardware addr type (net/if_types.h)
+			BYTE hlen;			  	// 2: Hardware addr length
+			BYTE hops;			  	// 3: Number of relay agent hops from client
+			DWORD xid;			  	// 4: Transaction ID
+			WORD secs;			  	// 8: Seconds since client started looking
+			WORD flags;			  	// 10: Flag bits
+			DWORD ciaddr;		  	// 12: Client IP address (if already in use)
+			DWORD yiaddr;		  	// 16: Client IP address
+			DWORD siaddr;		  	// 20: IP address of next server to talk to
+			DWORD giaddr;		  	// 24: DHCP relay agent IP address
+			BYTE chaddr[16];	  	// 28: Client hardware address
+			BYTE sname[64];		  	// 44: Server name
+			BYTE file[128];		  	// 108: Boot filename
+			DWORD magicCookie;		// 236: Optional parameters (First is MagicCookie)
+		} body;
+
+		struct RelayAgentInformation {
+			std::vector<BYTE> circuitId;
+			std::vector<BYTE> remoteId;
+		};
+
+		DHCPMessage();
+		DHCPMessage(std::vector<BYTE> data);
+
+		std::vector<BYTE> GetData();
+		void SetData(std::vector<BYTE> data);
+
+		std::vector<BYTE> GetOptionRaw(MessageOptionValues option) const;
+		void SetOptionRaw(MessageOptionValues option, std::vector<BYTE> data);
+		// Typed accessors; the value type is taken from the option schema at compile time
+		template <MessageOptionValues Option> auto GetOption();
+		template <MessageOptionValues Option, class T> void SetOption(T data);
+		void SetOption(MessageOptionValues option);
+
+		// Split the relay agent information option into its sub-options
+		RelayAgentInformation GetRelayAgentInformation() const;
+
+		static std::vector<BYTE> PByteToVByte(const BYTE *data, int size);
+	};
+
+	// Schema lookup indexed by option code, generated at compile time from DHCPMessage::OptionSchemaList
+	constexpr std::array<OptionSchema, 256> BuildOptionSchemaTable() {
+		std::array<OptionSchema, 256> table{};
+		for (size_t code = 0; code < table.size(); code++) {
+			table[code] = OptionSchema{ static_cast<BYTE>(code), OptionType::Binary, 0, 1020, false, true };
+		}
+		for (auto &&schema : DHCPMessage::OptionSchemaList) {
+			table[schema.code] = schema;
+		}
+		return table;
+	}
+	constexpr auto OptionSchemaTable = BuildOptionSchemaTable();
+
+	// Only concatenable options may need more than one instance on the wire (RFC 3396 section 5)
+	constexpr bool AreUnsplitOptionsShort() {
+		for (auto &&schema : OptionSchemaTable) {
+			if (!schema.concatenate && (MAX_OPTION_LENGTH < schema.maxLength)) return false;
+		}
+		return true;
+	}
+	static_assert(AreUnsplitOptionsShort(), "An option that cannot be split must fit in one instance.");
+
+	// True if a value of this size may be stored in the option the schema describes
+	bool IsValidOptionLength(const OptionSchema &schema, size_t size);
+
+	template <OptionType Type> struct OptionValue { typedef std::vector<BYTE> type; };
+	template <> struct OptionValue<OptionType::Byte> { typedef BYTE type; };
+	template <> struct OptionValue<OptionType::Word> { typedef WORD type; };
+	template <> struct OptionValue<OptionType::DWord> { typedef DWORD type; };
+	template <> struct OptionValue<OptionType::Address> { typedef DWORD type; };
+	template <> struct OptionValue<OptionType::AddressList> { typedef std::vector<DWORD> type; };
+	template <> struct OptionValue<OptionType::String> { typedef std::string type; };
+
+	// Value type of an option as declared by its schema entry
+	template <DHCPMessage::MessageOptionValues Option>
+	using OptionValueType = typename OptionValue<OptionSchemaTable[Option].type>::type;
+
+	template <DHCPMessage::MessageOptionValues Option> auto DHCPMessage::GetOption() {
+		typedef OptionValueType<Option> T;
+		static_assert(OptionSchemaTable[Option].type != OptionType::Empty, "Option carries no value.");
+
+		// Lengths were checked against the schema when the option was stored, so no size checks are needed here
+		auto raw = GetOptionRaw(Option);
+		T value{};
+		if constexpr (std::is_arithmetic_v<T>) {
+			if (raw.size() == sizeof(T)) std::memcpy(&value, raw.data(), sizeof(T));
+		}
+		else if constexpr (std::is_same_v<T, std::vector<DWORD>>) {
+			value.resize(raw.size() / sizeof(DWORD));
+			std::memcpy(value.data(), raw.data(), value.size() * sizeof(DWORD));
+		}
+		else if constexpr (std::is_same_v<T, std::string>) {
+			value.assign(raw.begin(), raw.end());
+		}
+		else {
+			value = std::move(raw);
+		}
+		return value;
+	}
+
+	template <DHCPMessage::MessageOptionValues Option, class T> void DHCPMessage::SetOption(T data) {
+		typedef OptionValueType<Option> V;
+		static_assert(OptionSchemaTable[Option].type != OptionType::Empty, "Option carries no value.");
+		static_assert(std::is_convertible_v<T, V>, "Value type does not match option schema.");
+
+		const V value = static_cast<V>(data);
+		if constexpr (std::is_arithmetic_v<V>) {
+			SetOptionRaw(Option, PByteToVByte(reinterpret_cast<const BYTE *>(&value), sizeof(V)));
+		}
+		else if constexpr (std::is_same_v<V, std::vector<DWORD>>) {
+			SetOptionRaw(Option, PByteToVByte(reinterpret_cast<const BYTE *>(value.data()), static_cast<int>(value.size() * sizeof(DWORD))));
+		}
+		else {
+			SetOptionRaw(Option, std::vector<BYTE>(value.begin(), value.end()));
+		}
+	}
+}
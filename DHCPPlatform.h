@@ -0,0 +1,112 @@
+#pragma once
+
+// Operating system headers and the few Win32 names the server uses. Windows builds use the real
+// headers; elsewhere the WinSock and Win32 names map onto their POSIX equivalents so the server
+// code keeps a single spelling.
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+#else
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <strings.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef unsigned long long ULONGLONG;
+typedef int BOOL;
+
+#define TRUE 1
+#define FALSE 0
+#define TEXT(x) x
+#define C_ASSERT(e) static_assert(e, #e)
+#define CopyMemory(destination, source, length) std::memcpy((destination), (source), (length))
+
+// WinSock
+typedef int SOCKET;
+typedef sockaddr SOCKADDR;
+typedef sockaddr_in SOCKADDR_IN;
+typedef sockaddr_in6 SOCKADDR_IN6;
+typedef ipv6_mreq IPV6_MREQ;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define NO_ERROR 0
+#define WSAENOTSOCK EBADF		// Socket was closed by Close()
+#define WSAEINTR EINTR
+#define WSAECONNRESET ECONNREFUSED	// ICMP port unreachable for an earlier datagram
+#define WSAEMSGSIZE EMSGSIZE
+
+// Longest hardware address IP Helper accepts
+#define MAXLEN_PHYSADDR 8
+
+inline int WSAGetLastError() {
+	return errno;
+}
+
+// closesocket wakes every thread blocked on the socket; close does not, so shut the socket down first
+inline int closesocket(SOCKET s) {
+	shutdown(s, SHUT_RDWR);
+	return close(s);
+}
+
+// Milliseconds since an arbitrary point, never going backwards
+inline ULONGLONG GetTickCount64() {
+	timespec tsNow{};
+	clock_gettime(CLOCK_MONOTONIC, &tsNow);
+	return static_cast<ULONGLONG>(tsNow.tv_sec) * 1000 + static_cast<ULONGLONG>(tsNow.tv_nsec) / 1000000;
+}
+
+inline DWORD GetCurrentProcessorNumber() {
+#ifdef __linux__
+	const int iProcessor = sched_getcpu();
+	return (0 <= iProcessor) ? static_cast<DWORD>(iProcessor) : 0;
+#else
+	return 0;
+#endif
+}
+
+// Secure CRT string functions, only in the forms the server calls them
+#define _TRUNCATE (static_cast<size_t>(-1))
+
+inline int strncpy_s(char *pcsDestination, size_t stDestinationSize, const char *pcsSource, size_t stCount) {
+	if ((nullptr == pcsDestination) || (0 == stDestinationSize)) {
+		return EINVAL;
+	}
+	const size_t stLimit = ((_TRUNCATE == stCount) || (stDestinationSize <= stCount)) ? (stDestinationSize - 1) : stCount;
+	const size_t stLength = strnlen(pcsSource, stLimit);
+	std::memcpy(pcsDestination, pcsSource, stLength);
+	pcsDestination[stLength] = '\0';
+	return 0;
+}
+
+inline int _stricmp(const char *pcsFirst, const char *pcsSecond) {
+	return strcasecmp(pcsFirst, pcsSecond);
+}
+
+// windows.h provides these as macros
+template <class T> constexpr const T &min(const T &a, const T &b) {
+	return (b < a) ? b : a;
+}
+template <class T> constexpr const T &max(const T &a, const T &b) {
+	return (a < b) ? b : a;
+}
+
+#endif
@@ -0,0 +1,327 @@
+#include "DHCPSimulator.h"
+#include <chrono>
+#include <cassert>
+#include <algorithm>
+
+using namespace DHCPLite;
+
+namespace {
+	// Magic cookie 99.130.83.99 (RFC 2131 section 3)
+	const DWORD SIMULATOR_MAGIC_COOKIE = 0x63825363;
+	// Seconds a client waits for its first reply before retransmitting, and the cap on backoff (RFC 2131 section 4.1)
+	const DWORD SIMULATOR_FIRST_RETRANSMIT = 4;
+	const DWORD SIMULATOR_MAX_RETRANSMIT = 64;
+	const ULONGLONG SECONDS_PER_HOUR = 60 * 60;
+}
+
+DHCPSimulator::DHCPSimulator(SimulationConfig config) : simulationConfig(config), rng(config.seed) {
+	if ((0 == simulationConfig.clientCount) || (0xffffff < simulationConfig.clientCount)) {
+		throw RequestException("Invalid simulation (client count must be between 1 and 16777215).");
+	}
+	if (0 == simulationConfig.poolSize) {
+		simulationConfig.poolSize = simulationConfig.clientCount + (simulationConfig.clientCount / 10);
+	}
+	simulationConfig.poolSize = min(simulationConfig.poolSize, static_cast<DWORD>(0xfffffd));
+
+	// 10.0.0.0/N just large enough for the server, the pool and the broadcast address
+	DWORD dwHostBits = 2;
+	while (((DWORD{ 1 } << dwHostBits) - 2) < (simulationConfig.poolSize + 1)) {
+		dwHostBits++;
+	}
+	const DWORD dwNetworkValue = 0x0a000000;
+	const DWORD dwMaskValue = ~((DWORD{ 1 } << dwHostBits) - 1);
+
+	DHCPServer::DHCPConfig serverConfig{};
+	serverConfig.addrInfo.address = DHCPServer::ValuetoIP(dwNetworkValue + 1);
+	serverConfig.addrInfo.mask = DHCPServer::ValuetoIP(dwMaskValue);
+	DHCPServer::SubnetConfig subnet{};
+	subnet.network = DHCPServer::ValuetoIP(dwNetworkValue);
+	subnet.mask = serverConfig.addrInfo.mask;
+	subnet.pools.emplace_back(DHCPServer::ValuetoIP(dwNetworkValue + 2), DHCPServer::ValuetoIP(dwNetworkValue + 1 + simulationConfig.poolSize));
+	subnet.leaseTime = simulationConfig.leaseTime;
+	serverConfig.subnets.push_back(subnet);
+
+	server.SetClock([this]() { return ullNow; });
+	server.SetSendCallback([this](const BYTE *pbData, int iDataSize, DWORD) {
+		vReplies.emplace_back(pbData, pbData + iDataSize);
+	});
+	server.Init(serverConfig);
+
+	// Everyone starts offline and boots at some point during the first hour
+	vClients.resize(simulationConfig.clientCount);
+	for (DWORD dwClient = 0; dwClient < simulationConfig.clientCount; dwClient++) {
+		VirtualClient &client = vClients[dwClient];
+		client = VirtualClient{};
+		client.state = Client_OFFLINE;
+		Schedule(dwClient, std::uniform_int_distribution<ULONGLONG>(0, SECONDS_PER_HOUR - 1)(rng));
+	}
+}
+
+ULONGLONG DHCPSimulator::RandomDuration(DWORD dwMean) {
+	// Exponentially distributed, at least one second so that every timer moves the clock forward
+	return max(ULONGLONG{ 1 }, static_cast<ULONGLONG>(std::exponential_distribution<double>(1.0 / max(dwMean, DWORD{ 1 }))(rng)));
+}
+
+bool DHCPSimulator::RandomPercent(DWORD dwPercent) {
+	return std::uniform_int_distribution<DWORD>(0, 99)(rng) < dwPercent;
+}
+
+void DHCPSimulator::Schedule(DWORD dwClient, ULONGLONG ullTime) {
+	VirtualClient &client = vClients[dwClient];
+	client.eventSequence++;
+	pqTimers.push(TimerEvent{ ullTime, client.eventSequence, dwClient });
+}
+
+void DHCPSimulator::SendRequest(DWORD dwClient, DHCPMessage::MessageTypes messageType, DWORD dwRequestedAddr, DWORD dwServerIdentifier, DWORD dwClientAddr) {
+	const VirtualClient &client = vClients[dwClient];
+
+	DHCPMessage requestMessage;
+	requestMessage.body.op = DHCPMessage::MsgOp_BOOT_REQUEST;
+	requestMessage.body.htype = 1; // Ethernet
+	requestMessage.body.hlen = 6;
+	requestMessage.body.xid = client.xid;
+	requestMessage.body.ciaddr = dwClientAddr;
+	// Locally administered MAC: 02-gg-gg-cc-cc-cc (generation, client index)
+	requestMessage.body.chaddr[0] = 0x02;
+	requestMessage.body.chaddr[1] = static_cast<BYTE>(client.generation >> 8);
+	requestMessage.body.chaddr[2] = static_cast<BYTE>(client.generation);
+	requestMessage.body.chaddr[3] = static_cast<BYTE>(dwClient >> 16);
+	requestMessage.body.chaddr[4] = static_cast<BYTE>(dwClient >> 8);
+	requestMessage.body.chaddr[5] = static_cast<BYTE>(dwClient);
+	requestMessage.body.magicCookie = htonl(SIMULATOR_MAGIC_COOKIE);
+	requestMessage.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(static_cast<BYTE>(messageType));
+	if (0 != dwRequestedAddr) {
+		requestMessage.SetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>(dwRequestedAddr);
+	}
+	if (0 != dwServerIdentifier) {
+		requestMessage.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(dwServerIdentifier);
+	}
+	requestMessage.SetOption(DHCPMessage::MsgOption_END);
+
+	switch (messageType) {
+	case DHCPMessage::MsgType_DISCOVER:
+		hourStatistics.discovers++;
+		break;
+	case DHCPMessage::MsgType_REQUEST:
+		hourStatistics.requests++;
+		break;
+	case DHCPMessage::MsgType_RELEASE:
+		hourStatistics.releases++;
+		break;
+	default:
+		break;
+	}
+	dqRequests.push_back(requestMessage.GetData());
+}
+
+void DHCPSimulator::SendDiscover(DWORD dwClient) {
+	VirtualClient &client = vClients[dwClient];
+	client.state = Client_SELECTING;
+	client.xid = rng();
+	client.address = 0;
+	client.retransmitDelay = SIMULATOR_FIRST_RETRANSMIT;
+	SendRequest(dwClient, DHCPMessage::MsgType_DISCOVER, 0, 0, 0);
+	Schedule(dwClient, ullNow + client.retransmitDelay);
+}
+
+void DHCPSimulator::Deliver() {
+	// Messages are delivered instantly; replies may trigger further requests, so drain until quiet
+	while (!dqRequests.empty()) {
+		const std::vector<BYTE> requestData = std::move(dqRequests.front());
+		dqRequests.pop_front();
+
+		const auto start = std::chrono::steady_clock::now();
+		if (!server.ProcessRequest(requestData.data(), static_cast<int>(requestData.size()))) {
+			hourStatistics.drops++;
+		}
+		hourStatistics.serverMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<std::vector<BYTE>> replies;
+		replies.swap(vReplies);
+		for (auto &&replyData : replies) {
+			DHCPMessage replyMessage(replyData);
+			HandleReply(replyMessage);
+		}
+	}
+}
+
+void DHCPSimulator::GoOffline(DWORD dwClient) {
+	VirtualClient &client = vClients[dwClient];
+	if ((0 != client.address) && RandomPercent(simulationConfig.releasePercent)) {
+		// RFC 2131 section 4.4.6 - the client forgets the address it released
+		SendRequest(dwClient, DHCPMessage::MsgType_RELEASE, 0, client.serverIdentifier, client.address);
+		client.address = 0;
+	}
+	client.state = Client_OFFLINE;
+	Schedule(dwClient, ullNow + RandomDuration(simulationConfig.offlineTime));
+}
+
+void DHCPSimulator::HandleTimer(DWORD dwClient) {
+	VirtualClient &client = vClients[dwClient];
+	const bool bSessionOver = (ullNow >= client.sessionEndTime);
+
+	switch (client.state) {
+	case Client_OFFLINE:
+		client.sessionEndTime = ullNow + RandomDuration(simulationConfig.sessionTime);
+		if (RandomPercent(simulationConfig.newDevicePercent)) {
+			// Different hardware address, so the server sees a brand new client
+			client.generation++;
+			client.address = 0;
+		}
+		if ((0 != client.address) && (ullNow < client.expireTime)) {
+			// RFC 2131 section 3.2 - INIT-REBOOT with the remembered address
+			client.state = Client_REBOOTING;
+			client.xid = rng();
+			client.retransmitDelay = SIMULATOR_FIRST_RETRANSMIT;
+			SendRequest(dwClient, DHCPMessage::MsgType_REQUEST, client.address, 0, 0);
+			Schedule(dwClient, ullNow + client.retransmitDelay);
+		}
+		else {
+			SendDiscover(dwClient);
+		}
+		break;
+	case Client_SELECTING:
+	case Client_REQUESTING:
+	case Client_REBOOTING:
+		// No usable reply - retransmit with backoff, restarting from DISCOVER
+		if (bSessionOver) {
+			GoOffline(dwClient);
+			break;
+		}
+		{
+			const DWORD dwRetransmitDelay = min(client.retransmitDelay * 2, SIMULATOR_MAX_RETRANSMIT);
+			SendDiscover(dwClient);
+			client.retransmitDelay = dwRetransmitDelay;
+			Schedule(dwClient, ullNow + client.retransmitDelay);
+		}
+		break;
+	case Client_BOUND:
+		if (bSessionOver) {
+			GoOffline(dwClient);
+			break;
+		}
+		// T1 reached - unicast DHCPREQUEST to the leasing server, which may be lost
+		client.state = Client_RENEWING;
+		client.xid = rng();
+		if (!RandomPercent(simulationConfig.lostRenewalPercent)) {
+			SendRequest(dwClient, DHCPMessage::MsgType_REQUEST, 0, 0, client.address);
+		}
+		Schedule(dwClient, min(client.rebindTime, client.sessionEndTime));
+		break;
+	case Client_RENEWING:
+		if (bSessionOver) {
+			GoOffline(dwClient);
+			break;
+		}
+		// T2 reached - broadcast DHCPREQUEST to any server
+		client.state = Client_REBINDING;
+		client.xid = rng();
+		SendRequest(dwClient, DHCPMessage::MsgType_REQUEST, 0, 0, client.address);
+		Schedule(dwClient, min(client.expireTime, client.sessionEndTime));
+		break;
+	case Client_REBINDING:
+		if (bSessionOver) {
+			GoOffline(dwClient);
+			break;
+		}
+		// Lease expired - back to INIT
+		SendDiscover(dwClient);
+		break;
+	default:
+		assert(!"Invalid client state");
+		break;
+	}
+}
+
+void DHCPSimulator::HandleReply(DHCPMessage &replyMessage) {
+	const DWORD dwClient = (static_cast<DWORD>(replyMessage.body.chaddr[3]) << 16)
+		| (static_cast<DWORD>(replyMessage.body.chaddr[4]) << 8) | replyMessage.body.chaddr[5];
+	const WORD generation = static_cast<WORD>((replyMessage.body.chaddr[1] << 8) | replyMessage.body.chaddr[2]);
+	if ((dwClient >= vClients.size()) || (generation != vClients[dwClient].generation)
+		|| (replyMessage.body.xid != vClients[dwClient].xid)) {
+		// Not for a current client transaction
+		return;
+	}
+	VirtualClient &client = vClients[dwClient];
+
+	switch (replyMessage.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>()) {
+	case DHCPMessage::MsgType_OFFER:
+		hourStatistics.offers++;
+		if (Client_SELECTING == client.state) {
+			client.state = Client_REQUESTING;
+			client.serverIdentifier = replyMessage.GetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>();
+			SendRequest(dwClient, DHCPMessage::MsgType_REQUEST, replyMessage.body.yiaddr, client.serverIdentifier, 0);
+			Schedule(dwClient, ullNow + client.retransmitDelay);
+		}
+		break;
+	case DHCPMessage::MsgType_ACK:
+		hourStatistics.acks++;
+		if ((Client_REQUESTING == client.state) || (Client_REBOOTING == client.state)
+			|| (Client_RENEWING == client.state) || (Client_REBINDING == client.state)) {
+			const ULONGLONG ullLeaseTime = ntohl(replyMessage.GetOption<DHCPMessage::MsgOption_ADDRESS_LEASETIME>());
+			client.state = Client_BOUND;
+			client.address = replyMessage.body.yiaddr;
+			client.serverIdentifier = replyMessage.GetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>();
+			// RFC 2131 section 4.4.5 default T1 and T2
+			client.renewTime = ullNow + max(ullLeaseTime / 2, ULONGLONG{ 1 });
+			client.rebindTime = ullNow + max((ullLeaseTime * 7) / 8, ULONGLONG{ 1 });
+			client.expireTime = ullNow + ullLeaseTime;
+			Schedule(dwClient, min(client.renewTime, client.sessionEndTime));
+		}
+		break;
+	case DHCPMessage::MsgType_NAK:
+		hourStatistics.naks++;
+		// RFC 2131 section 3.2 - start over
+		SendDiscover(dwClient);
+		break;
+	default:
+		break;
+	}
+}
+
+std::vector<DHCPSimulator::HourStatistics> DHCPSimulator::Run(HourCallback callback) {
+	std::vector<HourStatistics> statistics;
+
+	for (DWORD dwHour = 0; (dwHour * SECONDS_PER_HOUR) < simulationConfig.duration; dwHour++) {
+		hourStatistics = HourStatistics{};
+		hourStatistics.hour = dwHour;
+		hourStatistics.poolSize = simulationConfig.poolSize;
+		const ULONGLONG ullReclaimsBefore = server.GetReclaimCount();
+
+		const ULONGLONG ullHourEnd = min((dwHour + 1) * SECONDS_PER_HOUR, simulationConfig.duration);
+		while (!pqTimers.empty() && (pqTimers.top().time < ullHourEnd)) {
+			const TimerEvent timerEvent = pqTimers.top();
+			pqTimers.pop();
+			if (timerEvent.sequence != vClients[timerEvent.client].eventSequence) {
+				// Superseded by a later timer
+				continue;
+			}
+			ullNow = timerEvent.time;
+			HandleTimer(timerEvent.client);
+			Deliver();
+		}
+		ullNow = ullHourEnd;
+		hourStatistics.reclaims = static_cast<DWORD>(server.GetReclaimCount() - ullReclaimsBefore);
+
+		for (auto &&client : vClients) {
+			if ((Client_BOUND == client.state) || (Client_RENEWING == client.state) || (Client_REBINDING == client.state)) {
+				hourStatistics.boundClients++;
+			}
+		}
+		const auto leaseSnapshot = server.GetLeaseSnapshot();
+		hourStatistics.bindings = static_cast<DWORD>(leaseSnapshot->GetLeases().size());
+		hourStatistics.leaseTableBytes = server.GetLeaseTableMemoryUsage();
+		for (auto &&lease : leaseSnapshot->GetLeases()) {
+			if (!lease.clientIdentifier.empty() && (LEASE_NEVER_EXPIRES != lease.expireTime) && (ullNow < lease.expireTime)) {
+				hourStatistics.activeLeases++;
+			}
+		}
+
+		statistics.push_back(hourStatistics);
+		if (callback) {
+			callback(hourStatistics);
+		}
+	}
+
+	return statistics;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <queue>
+#include <random>
+#include <deque>
+#include "DHCPLite.h"
+
+namespace DHCPLite {
+	// Drives a population of virtual clients through DISCOVER/REQUEST/RENEW/REBIND/RELEASE against a
+	// DHCPServer using a virtual clock and in-memory transport, so simulated days run in seconds
+	class DHCPSimulator {
+	public:
+		struct SimulationConfig {
+			DWORD clientCount = 1000;
+			ULONGLONG duration = 24 * 60 * 60; // Simulated seconds
+			DWORD leaseTime = 60 * 60; // Seconds
+			DWORD poolSize = 0; // Addresses in the pool; 0 sizes the pool to the client count plus 10%
+			DWORD sessionTime = 8 * 60 * 60; // Mean seconds a client stays online
+			DWORD offlineTime = 4 * 60 * 60; // Mean seconds a client stays offline
+			DWORD releasePercent = 50; // Clients that send DHCPRELEASE when going offline
+			DWORD newDevicePercent = 5; // Clients that come back with a new hardware address
+			DWORD lostRenewalPercent = 10; // Unicast DHCPREQUESTs lost while RENEWING
+			DWORD seed = 1; // Same seed, same run
+		};
+
+		struct HourStatistics {
+			DWORD hour;
+			DWORD discovers;
+			DWORD requests;
+			DWORD releases;
+			DWORD offers;
+			DWORD acks;
+			DWORD naks;
+			DWORD drops; // Requests the server dropped (pool exhaustion included)
+			DWORD reclaims; // Stale bindings the server handed to new clients
+			DWORD boundClients; // Clients holding an address at the end of the hour
+			DWORD activeLeases; // Unexpired acknowledged leases at the end of the hour
+			DWORD poolSize;
+			DWORD bindings; // Entries in the lease table, expired ones included
+			size_t leaseTableBytes; // Memory allocated for the lease table
+			double serverMilliseconds; // Real time spent inside the server for this hour's requests
+		};
+
+		typedef std::function<void(const HourStatistics &statistics)> HourCallback;
+
+		DHCPSimulator(SimulationConfig config);
+
+		// Run the whole simulation, reporting each simulated hour as it completes
+		std::vector<HourStatistics> Run(HourCallback callback = nullptr);
+
+	private:
+		enum ClientStates {
+			Client_OFFLINE,
+			Client_SELECTING,
+			Client_REQUESTING,
+			Client_REBOOTING,
+			Client_BOUND,
+			Client_RENEWING,
+			Client_REBINDING,
+		};
+
+		struct VirtualClient {
+			ClientStates state;
+			WORD generation; // Bumped when the client returns as a new device
+			DWORD xid;
+			DWORD address; // Network order, 0 if none
+			DWORD serverIdentifier; // Network order
+			ULONGLONG renewTime; // T1
+			ULONGLONG rebindTime; // T2
+			ULONGLONG expireTime;
+			ULONGLONG sessionEndTime;
+			DWORD retransmitDelay; // Seconds, doubles on each retransmission (RFC 2131 section 4.1)
+			DWORD eventSequence; // Only the most recently scheduled timer is live
+		};
+
+		struct TimerEvent {
+			ULONGLONG time;
+			DWORD sequence;
+			DWORD client;
+
+			bool operator>(const TimerEvent &other) const {
+				return (time != other.time) ? (time > other.time) : (client > other.client);
+			}
+		};
+
+		SimulationConfig simulationConfig;
+		DHCPServer server;
+		ULONGLONG ullNow = 0;
+		std::mt19937 rng;
+		std::vector<VirtualClient> vClients;
+		std::priority_queue<TimerEvent, std::vector<TimerEvent>, std::greater<TimerEvent>> pqTimers;
+		std::deque<std::vector<BYTE>> dqRequests;
+		std::vector<std::vector<BYTE>> vReplies;
+		HourStatistics hourStatistics{};
+
+		ULONGLONG RandomDuration(DWORD dwMean);
+		bool RandomPercent(DWORD dwPercent);
+		void Schedule(DWORD dwClient, ULONGLONG ullTime);
+
+		void SendRequest(DWORD dwClient, DHCPMessage::MessageTypes messageType, DWORD dwRequestedAddr, DWORD dwServerIdentifier, DWORD dwClientAddr);
+		void SendDiscover(DWORD dwClient);
+		void Deliver();
+		void HandleTimer(DWORD dwClient);
+		void HandleReply(DHCPMessage &replyMessage);
+		void GoOffline(DWORD dwClient);
+	};
+}
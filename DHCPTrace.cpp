@@ -0,0 +1,194 @@
+#include "DHCPTrace.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+using namespace DHCPLite;
+
+static_assert(0 == (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)), "TRACE_RING_SIZE must be a power of two.");
+
+namespace {
+	const char *const STAGE_NAMES[Stage_COUNT] = { "recv", "parse", "lookup", "allocate", "encode", "send" };
+	const char *const RESULT_NAMES[] = { "ignored", "replied", "dropped" };
+	const char *const MESSAGE_TYPE_NAMES[] = { "UNKNOWN", "DISCOVER", "OFFER", "REQUEST", "DECLINE", "ACK", "NAK", "RELEASE", "INFORM" };
+	const char *const DHCPV6_MESSAGE_TYPE_NAMES[] = { "UNKNOWN6", "SOLICIT", "ADVERTISE", "REQUEST6", "CONFIRM", "RENEW", "REBIND",
+		"REPLY", "RELEASE6", "DECLINE6", "RECONFIGURE", "INFORMATION-REQUEST", "RELAY-FORW", "RELAY-REPL" };
+
+	const char *MessageTypeName(BYTE messageType) {
+		if (0 != (messageType & TRACE_DHCPV6_MESSAGE)) {
+			const BYTE type = messageType & ~TRACE_DHCPV6_MESSAGE;
+			return DHCPV6_MESSAGE_TYPE_NAMES[(type < (sizeof(DHCPV6_MESSAGE_TYPE_NAMES) / sizeof(DHCPV6_MESSAGE_TYPE_NAMES[0]))) ? type : 0];
+		}
+		return MESSAGE_TYPE_NAMES[(messageType < (sizeof(MESSAGE_TYPE_NAMES) / sizeof(MESSAGE_TYPE_NAMES[0]))) ? messageType : 0];
+	}
+
+	ULONGLONG LastStageTime(const PacketTrace &trace) {
+		return *std::max_element(std::begin(trace.stageTime), std::end(trace.stageTime));
+	}
+
+	void AppendJSONString(std::string &json, const std::string &value) {
+		json.push_back('"');
+		for (auto &&c : value) {
+			if (('"' == c) || ('\\' == c)) {
+				json.push_back('\\');
+			}
+			json.push_back((' ' <= c) ? c : ' ');
+		}
+		json.push_back('"');
+	}
+
+	void AppendPacketEvents(std::string &json, const PacketTrace &trace, int pid, size_t tid, const std::vector<BYTE> *pData, const std::string *pDropReason) {
+		static const char HEX_DIGITS[] = "0123456789abcdef";
+		const ULONGLONG ullStart = trace.stageTime[Stage_RECV];
+		char pcsXid[11];
+		snprintf(pcsXid, sizeof(pcsXid), "0x%08lx", static_cast<unsigned long>(trace.xid));
+
+		// Whole packet, with one nested slice per completed stage
+		json += "{\"name\":\"" + std::string(MessageTypeName(trace.messageType)) + "\",\"cat\":\"packet\",\"ph\":\"X\""
+			+ ",\"ts\":" + std::to_string(ullStart) + ",\"dur\":" + std::to_string(LastStageTime(trace) - ullStart)
+			+ ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(tid)
+			+ ",\"args\":{\"xid\":\"" + pcsXid + "\",\"result\":\"" + RESULT_NAMES[min(trace.result, BYTE{ Result_DROPPED })] + "\"";
+		if (nullptr != pData) {
+			json += ",\"data\":\"";
+			for (auto &&b : *pData) {
+				json.push_back(HEX_DIGITS[b >> 4]);
+				json.push_back(HEX_DIGITS[b & 0xf]);
+			}
+			json += "\"";
+		}
+		if ((nullptr != pDropReason) && !pDropReason->empty()) {
+			json += ",\"reason\":";
+			AppendJSONString(json, *pDropReason);
+		}
+		json += "}},\n";
+
+		ULONGLONG ullPrevious = ullStart;
+		for (size_t stage = Stage_RECV + 1; stage < Stage_COUNT; stage++) {
+			if (0 == trace.stageTime[stage]) {
+				continue;
+			}
+			json += "{\"name\":\"" + std::string(STAGE_NAMES[stage]) + "\",\"cat\":\"stage\",\"ph\":\"X\""
+				+ ",\"ts\":" + std::to_string(ullPrevious) + ",\"dur\":" + std::to_string(trace.stageTime[stage] - ullPrevious)
+				+ ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(tid) + "},\n";
+			ullPrevious = trace.stageTime[stage];
+		}
+	}
+}
+
+void PacketTrace::Mark(PacketStages stage) {
+	stageTime[stage] = FlightRecorder::Now();
+}
+
+FlightRecorder::FlightRecorder() : ullSlowThreshold(TRACE_SLOW_THRESHOLD_MICROSECONDS) {
+	const size_t stProcessors = max(std::thread::hardware_concurrency(), 1u);
+	for (size_t i = 0; i < stProcessors; i++) {
+		vProcessors.push_back(std::make_unique<ProcessorRecorder>());
+	}
+}
+
+ULONGLONG FlightRecorder::Now() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FlightRecorder::ProcessorRecorder &FlightRecorder::CurrentProcessor() {
+	// A thread migrating mid-packet only means the packet lands in a neighbour's ring
+	return *vProcessors[GetCurrentProcessorNumber() % vProcessors.size()];
+}
+
+void FlightRecorder::SetSlowThreshold(ULONGLONG microseconds) {
+	ullSlowThreshold.store(microseconds, std::memory_order_relaxed);
+}
+
+void FlightRecorder::Record(const PacketTrace &trace, const BYTE *pbData, int iDataSize, const char *pcsDropReason) {
+	ProcessorRecorder &processor = CurrentProcessor();
+
+	processor.received.fetch_add(1, std::memory_order_relaxed);
+	switch (trace.result) {
+	case Result_REPLIED:
+		processor.replied.fetch_add(1, std::memory_order_relaxed);
+		break;
+	case Result_DROPPED:
+		processor.dropped.fetch_add(1, std::memory_order_relaxed);
+		break;
+	default:
+		processor.ignored.fetch_add(1, std::memory_order_relaxed);
+		break;
+	}
+
+	// Sequence lock per slot - readers discard slots that change underneath them
+	const ULONGLONG ullIndex = processor.next.fetch_add(1, std::memory_order_relaxed);
+	TraceSlot &slot = processor.slots[ullIndex & (TRACE_RING_SIZE - 1)];
+	slot.sequence.store((ullIndex * 2) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (size_t stage = 0; stage < Stage_COUNT; stage++) {
+		slot.stageTime[stage].store(trace.stageTime[stage], std::memory_order_relaxed);
+	}
+	slot.xid.store(trace.xid, std::memory_order_relaxed);
+	slot.info.store(trace.messageType | (static_cast<DWORD>(trace.result) << 8), std::memory_order_relaxed);
+	slot.sequence.store((ullIndex * 2) + 2, std::memory_order_release);
+
+	const bool bSlow = (LastStageTime(trace) - trace.stageTime[Stage_RECV]) > ullSlowThreshold.load(std::memory_order_relaxed);
+	if (bSlow || (Result_DROPPED == trace.result)) {
+		if (bSlow) {
+			processor.slow.fetch_add(1, std::memory_order_relaxed);
+		}
+		std::lock_guard<std::mutex> lock(mSlowPackets);
+		SlowPacket &slowPacket = slowPackets[stNextSlowPacket++ % slowPackets.size()];
+		slowPacket.trace = trace;
+		slowPacket.data.assign(pbData, pbData + min(iDataSize, static_cast<int>(TRACE_PACKET_SIZE)));
+		slowPacket.dropReason = (nullptr != pcsDropReason) ? pcsDropReason : "";
+	}
+}
+
+PacketStatistics FlightRecorder::GetStatistics() const {
+	PacketStatistics statistics{};
+	for (auto &&processor : vProcessors) {
+		statistics.received += processor->received.load(std::memory_order_relaxed);
+		statistics.replied += processor->replied.load(std::memory_order_relaxed);
+		statistics.ignored += processor->ignored.load(std::memory_order_relaxed);
+		statistics.dropped += processor->dropped.load(std::memory_order_relaxed);
+		statistics.slow += processor->slow.load(std::memory_order_relaxed);
+	}
+	return statistics;
+}
+
+std::string FlightRecorder::GetChromeTrace() const {
+	std::string json = "{\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Recent packets (by processor)\"}},\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"Slow and dropped packets\"}},\n";
+
+	for (size_t stProcessor = 0; stProcessor < vProcessors.size(); stProcessor++) {
+		for (auto &&slot : vProcessors[stProcessor]->slots) {
+			const ULONGLONG ullSequence = slot.sequence.load(std::memory_order_acquire);
+			if ((0 == ullSequence) || (0 != (ullSequence & 1))) {
+				continue;
+			}
+			PacketTrace trace{};
+			for (size_t stage = 0; stage < Stage_COUNT; stage++) {
+				trace.stageTime[stage] = slot.stageTime[stage].load(std::memory_order_relaxed);
+			}
+			trace.xid = slot.xid.load(std::memory_order_relaxed);
+			const DWORD dwInfo = slot.info.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (ullSequence != slot.sequence.load(std::memory_order_relaxed)) {
+				// Overwritten while copying
+				continue;
+			}
+			trace.messageType = static_cast<BYTE>(dwInfo);
+			trace.result = static_cast<BYTE>(dwInfo >> 8);
+			AppendPacketEvents(json, trace, 1, stProcessor, nullptr, nullptr);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mSlowPackets);
+		for (size_t i = 0; i < min(stNextSlowPacket, slowPackets.size()); i++) {
+			AppendPacketEvents(json, slowPackets[i].trace, 2, 0, &slowPackets[i].data, &slowPackets[i].dropReason);
+		}
+	}
+
+	// Metadata event last so every packet event can end with a comma
+	json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"kept in full\"}}\n]}\n";
+	return json;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "DHCPPlatform.h"
+
+namespace DHCPLite {
+	// Flight-recorder slots per processor (power of two)
+	constexpr auto TRACE_RING_SIZE = 1024;
+	// Slow or dropped packets kept in full
+	constexpr auto TRACE_SLOW_RING_SIZE = 64;
+	// Largest request kept with a slow packet (Ethernet MTU)
+	constexpr auto TRACE_PACKET_SIZE = 1500;
+	// Default latency above which a packet is kept in full
+	constexpr auto TRACE_SLOW_THRESHOLD_MICROSECONDS = 1000;
+	// Set in PacketTrace::messageType for DHCPv6 messages
+	constexpr BYTE TRACE_DHCPV6_MESSAGE = 0x80;
+
+	// Stages a request passes through; each is stamped when it completes
+	enum PacketStages {
+		Stage_RECV,
+		Stage_PARSE,
+		Stage_LOOKUP,
+		Stage_ALLOCATE,
+		Stage_ENCODE,
+		Stage_SEND,
+		Stage_COUNT,
+	};
+
+	enum PacketResults {
+		Result_IGNORED, // Handled without a reply
+		Result_REPLIED,
+		Result_DROPPED, // Processing threw
+	};
+
+	// Timeline of one request, filled in by the receive loop
+	struct PacketTrace {
+		ULONGLONG stageTime[Stage_COUNT]; // Microseconds on the trace clock, 0 if the stage was not reached
+		DWORD xid;
+		BYTE messageType; // DHCPv6 message types have TRACE_DHCPV6_MESSAGE set
+		BYTE result;
+
+		void Mark(PacketStages stage);
+	};
+
+	struct PacketStatistics {
+		ULONGLONG received;
+		ULONGLONG replied;
+		ULONGLONG ignored;
+		ULONGLONG dropped;
+		ULONGLONG slow;
+	};
+
+	// Per-processor statistics and ring of recent packet timelines. Recording never takes a lock;
+	// only packets above the latency threshold (or dropped) go to the shared slow-packet ring
+	class FlightRecorder {
+	public:
+		FlightRecorder();
+
+		// Record a finished request; pbData (and pcsDropReason) are kept if the request was slow or dropped
+		void Record(const PacketTrace &trace, const BYTE *pbData, int iDataSize, const char *pcsDropReason = nullptr);
+
+		void SetSlowThreshold(ULONGLONG microseconds);
+
+		PacketStatistics GetStatistics() const;
+
+		// Recent and slow packets as Chrome trace event JSON (chrome://tracing, Perfetto)
+		std::string GetChromeTrace() const;
+
+		// Microseconds on the trace clock
+		static ULONGLONG Now();
+
+	private:
+		struct TraceSlot {
+			std::atomic<ULONGLONG> sequence; // Odd while being written
+			std::array<std::atomic<ULONGLONG>, Stage_COUNT> stageTime;
+			std::atomic<DWORD> xid;
+			std::atomic<DWORD> info; // messageType | result << 8
+		};
+
+		// One per processor, on its own cache lines so counters are never shared between cores
+		struct alignas(64) ProcessorRecorder {
+			std::atomic<ULONGLONG> received;
+			std::atomic<ULONGLONG> replied;
+			std::atomic<ULONGLONG> ignored;
+			std::atomic<ULONGLONG> dropped;
+			std::atomic<ULONGLONG> slow;
+			std::atomic<ULONGLONG> next; // Next slot to write
+			std::array<TraceSlot, TRACE_RING_SIZE> slots;
+		};
+
+		struct SlowPacket {
+			PacketTrace trace;
+			std::vector<BYTE> data;
+			std::string dropReason;
+		};
+
+		std::vector<std::unique_ptr<ProcessorRecorder>> vProcessors;
+		std::atomic<ULONGLONG> ullSlowThreshold;
+
+		mutable std::mutex mSlowPackets; // Slow packets are rare, so their ring is simply locked
+		std::array<SlowPacket, TRACE_SLOW_RING_SIZE> slowPackets;
+		size_t stNextSlowPacket = 0;
+
+		ProcessorRecorder &CurrentProcessor();
+	};
+}
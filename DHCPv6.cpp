@@ -0,0 +1,405 @@
+#include "DHCPv6.h"
+#ifdef _WIN32
+#include <iphlpapi.h>
+#else
+#include <ifaddrs.h>
+#include <linux/if_packet.h>
+#endif
+#include <algorithm>
+
+using namespace DHCPLite;
+
+namespace {
+	// Hashed probes before falling back to a scan (only small pools ever get that far)
+	const DWORD DHCPV6_ALLOCATION_PROBES = 64;
+	// The prefix is the engine's only pool
+	const DWORD DHCPV6_POOL = 0;
+	// Pools up to this many host bits are scanned once the probes run out
+	const DWORD DHCPV6_SCAN_HOST_BITS = 20;
+
+	WORD ReadWord(const BYTE *pbData) {
+		return static_cast<WORD>((pbData[0] << 8) | pbData[1]);
+	}
+
+	void AppendWord(std::vector<BYTE> &data, WORD value) {
+		data.push_back(static_cast<BYTE>(value >> 8));
+		data.push_back(static_cast<BYTE>(value));
+	}
+
+	void AppendDWord(std::vector<BYTE> &data, DWORD value) {
+		AppendWord(data, static_cast<WORD>(value >> 16));
+		AppendWord(data, static_cast<WORD>(value));
+	}
+
+	void AppendOption(std::vector<BYTE> &data, WORD code, const BYTE *pbData, size_t size) {
+		AppendWord(data, code);
+		AppendWord(data, static_cast<WORD>(size));
+		data.insert(data.end(), pbData, pbData + size);
+	}
+
+	// Status Code option (RFC 8415 section 21.13) with an empty message
+	void AppendStatus(std::vector<BYTE> &data, WORD status) {
+		AppendWord(data, DHCPv6Message::MsgOption_STATUS_CODE);
+		AppendWord(data, 2);
+		AppendWord(data, status);
+	}
+}
+
+bool DHCPLite::StringToIPv6Address(const std::string &text, IPv6Address &address) {
+	return 1 == inet_pton(AF_INET6, text.c_str(), address.data());
+}
+
+std::string DHCPLite::IPv6AddressToString(const IPv6Address &address) {
+	char pcsAddress[INET6_ADDRSTRLEN];
+	return (nullptr != inet_ntop(AF_INET6, address.data(), pcsAddress, sizeof(pcsAddress))) ? pcsAddress : "";
+}
+
+DHCPv6Message::DHCPv6Message(const BYTE *pbData, int iDataSize) {
+	// msg-type (1), transaction-id (3), options
+	if (iDataSize < 4) {
+		throw MessageException("Invalid DHCPv6 message (too short).");
+	}
+	messageType = pbData[0];
+	pbTransactionId = pbData + 1;
+	ParseOptions(pbData + 4, iDataSize - 4, options);
+}
+
+const DHCPv6Message::Option *DHCPv6Message::FindOption(WORD code) const {
+	for (auto &&option : options) {
+		if (code == option.code) {
+			return &option;
+		}
+	}
+	return nullptr;
+}
+
+void DHCPv6Message::ParseOptions(const BYTE *pbData, size_t size, std::vector<Option> &options) {
+	options.clear();
+	for (size_t stOffset = 0; stOffset < size;) {
+		if (size - stOffset < 4) {
+			throw MessageException("Invalid DHCPv6 message (truncated option header).");
+		}
+		const WORD length = ReadWord(pbData + stOffset + 2);
+		if (size - stOffset - 4 < length) {
+			throw MessageException("Invalid DHCPv6 message (option runs past end of message).");
+		}
+		options.push_back(Option{ ReadWord(pbData + stOffset), length, pbData + stOffset + 4 });
+		stOffset += 4 + length;
+	}
+}
+
+DHCPv6Engine::DHCPv6Engine(DHCPServer::DHCPv6Config config, DHCPServer::ClockFunction clock) : config(config), clock(clock) {
+	if ((0 == config.prefixLength) || (120 < config.prefixLength)) {
+		throw ConfigException("Invalid DHCPv6 prefix length " + std::to_string(config.prefixLength) + " (expected 1 to 120).");
+	}
+	if (config.serverDuid.empty()) {
+		throw ConfigException("DHCPv6 requires a server DUID.");
+	}
+	if (config.validLifetime < config.preferredLifetime) {
+		throw ConfigException("DHCPv6 valid lifetime is shorter than the preferred lifetime.");
+	}
+
+	// Keep only the prefix bits so that host bits can simply be or'ed in
+	for (size_t i = 0; i < DHCPv6Engine::config.prefix.size(); i++) {
+		const int iPrefixBits = max(0, min(8, static_cast<int>(config.prefixLength) - static_cast<int>(i * 8)));
+		DHCPv6Engine::config.prefix[i] &= static_cast<BYTE>(0xff00 >> iPrefixBits);
+	}
+}
+
+bool DHCPv6Engine::IsOnLink(const IPv6Address &address) const {
+	for (size_t i = 0; i < address.size(); i++) {
+		const int iPrefixBits = max(0, min(8, static_cast<int>(config.prefixLength) - static_cast<int>(i * 8)));
+		if (config.prefix[i] != (address[i] & static_cast<BYTE>(0xff00 >> iPrefixBits))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+DHCPv6Engine::LeaseTable6::LeaseHandle DHCPv6Engine::Allocate(const std::vector<BYTE> &leaseKey) {
+	// Interface identifiers are drawn from a sequence seeded by the lease key, so a client gets the same
+	// address back whenever it is free, and a sparse /64 needs no free list or scan - the first probe
+	// almost always lands on an unused address
+	const DWORD dwHostBits = min(128 - static_cast<DWORD>(config.prefixLength), DWORD{ 64 });
+	const ULONGLONG ullHostMask = (64 == dwHostBits) ? ~0ULL : ((1ULL << dwHostBits) - 1);
+	ULONGLONG ullState = HashClientIdentifier(leaseKey.data(), leaseKey.size());
+
+	auto tryHost = [&](ULONGLONG ullHost) {
+		// Skip the Subnet-Router anycast address (RFC 4291 section 2.6.1) and reserved anycast IDs (RFC 2526)
+		if ((0 == ullHost) || (ullHostMask - 127 <= ullHost)) {
+			return LeaseTable6::INVALID_LEASE_HANDLE;
+		}
+		IPv6Address address = config.prefix;
+		for (size_t i = 0; i < 8; i++) {
+			address[8 + i] |= static_cast<BYTE>(ullHost >> (56 - (i * 8)));
+		}
+		if (LeaseTable6::INVALID_LEASE_HANDLE != leaseTable.FindByAddress(address)) {
+			return LeaseTable6::INVALID_LEASE_HANDLE;
+		}
+		const auto lhLease = leaseTable.Add(address, leaseKey.data(), static_cast<DWORD>(leaseKey.size()), true, DHCPV6_POOL);
+		leaseTable.Touch(lhLease, clock());
+		return lhLease;
+	};
+
+	ULONGLONG ullHost = 0;
+	for (DWORD dwProbe = 0; dwProbe < DHCPV6_ALLOCATION_PROBES; dwProbe++) {
+		// 64-bit LCG; the high bits are the well-mixed ones
+		ullState = (ullState * 6364136223846793005ULL) + 1442695040888963407ULL;
+		ullHost = (ullState >> (64 - dwHostBits)) & ullHostMask;
+		const auto lhLease = tryHost(ullHost);
+		if (LeaseTable6::INVALID_LEASE_HANDLE != lhLease) {
+			return lhLease;
+		}
+	}
+	if (dwHostBits <= DHCPV6_SCAN_HOST_BITS) {
+		// Nearly full small pool - walk it once from the last probe
+		for (ULONGLONG ullStep = 1; ullStep <= ullHostMask; ullStep++) {
+			const auto lhLease = tryHost((ullHost + ullStep) & ullHostMask);
+			if (LeaseTable6::INVALID_LEASE_HANDLE != lhLease) {
+				return lhLease;
+			}
+		}
+	}
+	// Full - take over the least recently seen binding if that client is gone
+	return leaseTable.Reclaim(DHCPV6_POOL, clock(), 0, leaseKey.data(), static_cast<DWORD>(leaseKey.size()), [this](const IPv6Address &address) {
+		return IsOnLink(address);
+		});
+}
+
+void DHCPv6Engine::AppendIA(std::vector<BYTE> &reply, BYTE messageType, const DHCPv6Message::Option &ia, const DHCPv6Message::Option &clientId) {
+	// IA_NA - IAID (4), T1 (4), T2 (4), IA_NA-options (RFC 8415 section 21.4)
+	if (ia.length < 12) {
+		throw MessageException("Invalid DHCPv6 message (IA_NA too short).");
+	}
+	if ((0 == clientId.length) || (DHCPv6Message::MAX_DUID_LENGTH < clientId.length)) {
+		throw MessageException("Invalid DHCPv6 message (bad client DUID length).");
+	}
+	DHCPv6Message::ParseOptions(ia.pbData + 12, ia.length - 12, vIAOptions);
+
+	// One binding per IA: keyed by IAID followed by the client DUID
+	vLeaseKey.assign(ia.pbData, ia.pbData + 4);
+	vLeaseKey.insert(vLeaseKey.end(), clientId.pbData, clientId.pbData + clientId.length);
+	LeaseTable6::LeaseHandle lhLease = leaseTable.FindByClientIdentifier(vLeaseKey.data(), static_cast<DWORD>(vLeaseKey.size()));
+	if (LeaseTable6::INVALID_LEASE_HANDLE != lhLease) {
+		leaseTable.Touch(lhLease, clock());
+	}
+
+	WORD status = DHCPv6Message::Status_SUCCESS;
+	switch (messageType) {
+	case DHCPv6Message::MsgType_SOLICIT:
+	case DHCPv6Message::MsgType_REQUEST:
+		if (LeaseTable6::INVALID_LEASE_HANDLE == lhLease) {
+			lhLease = Allocate(vLeaseKey);
+		}
+		if (LeaseTable6::INVALID_LEASE_HANDLE == lhLease) {
+			status = DHCPv6Message::Status_NO_ADDRS_AVAIL;
+		}
+		break;
+	case DHCPv6Message::MsgType_RENEW:
+	case DHCPv6Message::MsgType_REBIND:
+	case DHCPv6Message::MsgType_RELEASE:
+		if (LeaseTable6::INVALID_LEASE_HANDLE == lhLease) {
+			status = DHCPv6Message::Status_NO_BINDING;
+		}
+		break;
+	default:
+		assert(!"Unexpected DHCPv6 message type with IA_NA");
+		return;
+	}
+
+	if (DHCPv6Message::MsgType_RELEASE == messageType) {
+		// RFC 8415 section 18.3.7 - only IAs without a binding are listed in the reply
+		if (DHCPv6Message::Status_SUCCESS == status) {
+			leaseTable.SetExpireTime(lhLease, clock());
+			leaseTable.Retire(lhLease);
+			return;
+		}
+	}
+	else if ((DHCPv6Message::Status_SUCCESS == status) && (DHCPv6Message::MsgType_SOLICIT != messageType)) {
+		// Request, Renew and Rebind commit the binding (a rapid-commit Solicit is handled as a Request)
+		leaseTable.SetExpireTime(lhLease, clock() + config.validLifetime);
+	}
+
+	const size_t stIAOffset = reply.size();
+	AppendOption(reply, DHCPv6Message::MsgOption_IA_NA, ia.pbData, 4);
+	if (DHCPv6Message::Status_SUCCESS == status) {
+		// RFC 8415 section 21.4 recommended T1 and T2 (0.5 and 0.8 of the preferred lifetime)
+		AppendDWord(reply, config.preferredLifetime / 2);
+		AppendDWord(reply, static_cast<DWORD>((static_cast<ULONGLONG>(config.preferredLifetime) * 4) / 5));
+		// IAADDR - address (16), preferred-lifetime (4), valid-lifetime (4) (RFC 8415 section 21.6)
+		const IPv6Address &address = leaseTable.GetAddress(lhLease);
+		AppendWord(reply, DHCPv6Message::MsgOption_IAADDR);
+		AppendWord(reply, 24);
+		reply.insert(reply.end(), address.begin(), address.end());
+		AppendDWord(reply, config.preferredLifetime);
+		AppendDWord(reply, config.validLifetime);
+	}
+	else {
+		AppendDWord(reply, 0);
+		AppendDWord(reply, 0);
+		AppendStatus(reply, status);
+	}
+	// Patch the IA_NA length now that its options are known
+	const size_t stIALength = reply.size() - stIAOffset - 4;
+	reply[stIAOffset + 2] = static_cast<BYTE>(stIALength >> 8);
+	reply[stIAOffset + 3] = static_cast<BYTE>(stIALength);
+}
+
+bool DHCPv6Engine::ProcessRequest(const BYTE *pbData, int iDataSize, std::vector<BYTE> &reply, PacketTrace &trace) {
+	const DHCPv6Message requestMessage(pbData, iDataSize);
+	const BYTE *pbTransactionId = requestMessage.GetTransactionId();
+	BYTE messageType = requestMessage.GetMessageType();
+	trace.messageType = static_cast<BYTE>(TRACE_DHCPV6_MESSAGE | messageType);
+	trace.xid = (static_cast<DWORD>(pbTransactionId[0]) << 16) | (static_cast<DWORD>(pbTransactionId[1]) << 8) | pbTransactionId[2];
+	trace.Mark(Stage_PARSE);
+
+	const DHCPv6Message::Option *pClientId = requestMessage.FindOption(DHCPv6Message::MsgOption_CLIENTID);
+	const DHCPv6Message::Option *pServerId = requestMessage.FindOption(DHCPv6Message::MsgOption_SERVERID);
+	const bool bForUs = (nullptr != pServerId) && (config.serverDuid.size() == pServerId->length)
+		&& (0 == memcmp(config.serverDuid.data(), pServerId->pbData, pServerId->length));
+	const bool bRapidCommit = (nullptr != requestMessage.FindOption(DHCPv6Message::MsgOption_RAPID_COMMIT));
+
+	// RFC 8415 section 16 - discard messages that are not valid for a server to answer
+	BYTE replyType = DHCPv6Message::MsgType_REPLY;
+	switch (messageType) {
+	case DHCPv6Message::MsgType_SOLICIT:
+		if ((nullptr == pClientId) || (nullptr != pServerId)) return false;
+		if (!bRapidCommit) {
+			replyType = DHCPv6Message::MsgType_ADVERTISE;
+		}
+		break;
+	case DHCPv6Message::MsgType_REQUEST:
+	case DHCPv6Message::MsgType_RENEW:
+	case DHCPv6Message::MsgType_RELEASE:
+		if ((nullptr == pClientId) || !bForUs) return false;
+		break;
+	case DHCPv6Message::MsgType_REBIND:
+	case DHCPv6Message::MsgType_CONFIRM:
+		if ((nullptr == pClientId) || (nullptr != pServerId)) return false;
+		break;
+	case DHCPv6Message::MsgType_INFORMATION_REQUEST:
+		if ((nullptr != pServerId) && !bForUs) return false;
+		break;
+	default:
+		// UNSUPPORTED: Decline, relayed messages; anything else is not for a server
+		return false;
+	}
+	trace.Mark(Stage_LOOKUP);
+
+	// msg-type, transaction-id, Server Identifier, Client Identifier (RFC 8415 section 18.3)
+	reply.assign({ replyType, pbTransactionId[0], pbTransactionId[1], pbTransactionId[2] });
+	AppendOption(reply, DHCPv6Message::MsgOption_SERVERID, config.serverDuid.data(), config.serverDuid.size());
+	if (nullptr != pClientId) {
+		AppendOption(reply, DHCPv6Message::MsgOption_CLIENTID, pClientId->pbData, pClientId->length);
+	}
+
+	switch (messageType) {
+	case DHCPv6Message::MsgType_CONFIRM:
+	{
+		// RFC 8415 section 18.3.3 - only whether the addresses are still on this link
+		WORD status = DHCPv6Message::Status_SUCCESS;
+		for (auto &&ia : requestMessage.GetOptions()) {
+			if ((DHCPv6Message::MsgOption_IA_NA != ia.code) || (ia.length < 12)) continue;
+			DHCPv6Message::ParseOptions(ia.pbData + 12, ia.length - 12, vIAOptions);
+			for (auto &&iaAddress : vIAOptions) {
+				IPv6Address address;
+				if ((DHCPv6Message::MsgOption_IAADDR != iaAddress.code) || (iaAddress.length < address.size())) continue;
+				std::copy_n(iaAddress.pbData, address.size(), address.begin());
+				if (!IsOnLink(address)) {
+					status = DHCPv6Message::Status_NOT_ON_LINK;
+				}
+			}
+		}
+		AppendStatus(reply, status);
+		break;
+	}
+	case DHCPv6Message::MsgType_INFORMATION_REQUEST:
+		break;
+	default:
+		if (DHCPv6Message::MsgType_SOLICIT == messageType && bRapidCommit) {
+			// RFC 8415 section 18.3.1 - commit straight away and say so
+			AppendOption(reply, DHCPv6Message::MsgOption_RAPID_COMMIT, nullptr, 0);
+			messageType = DHCPv6Message::MsgType_REQUEST;
+		}
+		for (auto &&option : requestMessage.GetOptions()) {
+			if (DHCPv6Message::MsgOption_IA_NA == option.code) {
+				AppendIA(reply, messageType, option, *pClientId);
+			}
+		}
+		if (DHCPv6Message::MsgType_RELEASE == messageType) {
+			AppendStatus(reply, DHCPv6Message::Status_SUCCESS);
+		}
+		break;
+	}
+	trace.Mark(Stage_ALLOCATE);
+
+	// DNS Recursive Name Server (RFC 3646) when asked for in the Option Request option
+	const DHCPv6Message::Option *pRequestedOptions = requestMessage.FindOption(DHCPv6Message::MsgOption_ORO);
+	if (!config.dnsServers.empty() && (nullptr != pRequestedOptions)) {
+		for (size_t i = 0; i + 1 < pRequestedOptions->length; i += 2) {
+			if (DHCPv6Message::MsgOption_DNS_SERVERS == ReadWord(pRequestedOptions->pbData + i)) {
+				AppendWord(reply, DHCPv6Message::MsgOption_DNS_SERVERS);
+				AppendWord(reply, static_cast<WORD>(config.dnsServers.size() * sizeof(IPv6Address)));
+				for (auto &&server : config.dnsServers) {
+					reply.insert(reply.end(), server.begin(), server.end());
+				}
+				break;
+			}
+		}
+	}
+	trace.Mark(Stage_ENCODE);
+	return true;
+}
+
+std::vector<DHCPv6Engine::LeaseInformation> DHCPv6Engine::GetLeases() const {
+	std::vector<LeaseTable6::Lease> vLeases;
+	std::vector<BYTE> vIdentifiers;
+	ULONGLONG ullGeneration;
+	std::vector<LeaseInformation> leases;
+	if (leaseTable.Copy(~0ULL, vLeases, vIdentifiers, ullGeneration)) {
+		leases.reserve(vLeases.size());
+		for (auto &&lease : vLeases) {
+			auto itIdentifier = vIdentifiers.begin() + lease.dwClientIdentifierOffset;
+			leases.push_back(LeaseInformation{ lease.address,
+				std::vector<BYTE>(itIdentifier, itIdentifier + lease.dwClientIdentifierSize), lease.ullExpireTime });
+		}
+	}
+	std::sort(leases.begin(), leases.end(), [](const LeaseInformation &a, const LeaseInformation &b) {
+		return a.address < b.address;
+		});
+	return leases;
+}
+
+std::vector<BYTE> DHCPv6Engine::GetInterfaceDuid(DWORD dwInterfaceIndex) {
+	// DUID-LL: type 3, hardware type 1 (Ethernet), link-layer address
+	std::vector<BYTE> duid{ 0, 3, 0, 1 };
+
+#ifdef _WIN32
+	MIB_IFROW mirInterfaceRow{};
+	mirInterfaceRow.dwIndex = dwInterfaceIndex;
+	if ((NO_ERROR != GetIfEntry(&mirInterfaceRow)) || (0 == mirInterfaceRow.dwPhysAddrLen)) {
+		throw IPAddrException("Unable to determine a hardware address for the DHCPv6 server DUID.");
+	}
+	duid.insert(duid.end(), mirInterfaceRow.bPhysAddr, mirInterfaceRow.bPhysAddr + mirInterfaceRow.dwPhysAddrLen);
+#else
+	// The link-layer address is reported as the interface's AF_PACKET entry
+	ifaddrs *piaAddrList = nullptr;
+	if (SOCKET_ERROR != getifaddrs(&piaAddrList)) {
+		for (const ifaddrs *piaAddr = piaAddrList; nullptr != piaAddr; piaAddr = piaAddr->ifa_next) {
+			if ((nullptr == piaAddr->ifa_addr) || (AF_PACKET != piaAddr->ifa_addr->sa_family)) {
+				continue;
+			}
+			const sockaddr_ll *const psaLinkAddress = reinterpret_cast<const sockaddr_ll *>(piaAddr->ifa_addr);
+			if (static_cast<int>(dwInterfaceIndex) == psaLinkAddress->sll_ifindex) {
+				duid.insert(duid.end(), psaLinkAddress->sll_addr, psaLinkAddress->sll_addr + psaLinkAddress->sll_halen);
+				break;
+			}
+		}
+		freeifaddrs(piaAddrList);
+	}
+	if (4 == duid.size()) {
+		throw IPAddrException("Unable to determine a hardware address for the DHCPv6 server DUID.");
+	}
+#endif
+	return duid;
+}
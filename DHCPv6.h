@@ -0,0 +1,117 @@
+#pragma once
+
+#include "DHCPLite.h"
+
+namespace DHCPLite {
+	struct IPv6AddressHash {
+		size_t operator()(const IPv6Address &address) const {
+			return static_cast<size_t>(HashClientIdentifier(address.data(), address.size()));
+		}
+	};
+
+	bool StringToIPv6Address(const std::string &text, IPv6Address &address);
+	std::string IPv6AddressToString(const IPv6Address &address);
+
+	// Read-only view of a DHCPv6 message (RFC 8415 section 8). Options are located in place in the
+	// caller's buffer - nothing is copied - so the view is only valid while that buffer is.
+	class DHCPv6Message {
+	public:
+		// Longest DUID (RFC 8415 section 11.1)
+		static constexpr WORD MAX_DUID_LENGTH = 130;
+
+		enum MessageTypes { // RFC 8415 section 7.3
+			MsgType_SOLICIT = 1,
+			MsgType_ADVERTISE = 2,
+			MsgType_REQUEST = 3,
+			MsgType_CONFIRM = 4,
+			MsgType_RENEW = 5,
+			MsgType_REBIND = 6,
+			MsgType_REPLY = 7,
+			MsgType_RELEASE = 8,
+			MsgType_DECLINE = 9,
+			MsgType_RECONFIGURE = 10,
+			MsgType_INFORMATION_REQUEST = 11,
+			MsgType_RELAY_FORW = 12,
+			MsgType_RELAY_REPL = 13,
+		};
+		enum MessageOptionValues { // RFC 8415 section 21, RFC 3646
+			MsgOption_CLIENTID = 1,
+			MsgOption_SERVERID = 2,
+			MsgOption_IA_NA = 3,
+			MsgOption_IAADDR = 5,
+			MsgOption_ORO = 6,
+			MsgOption_ELAPSED_TIME = 8,
+			MsgOption_STATUS_CODE = 13,
+			MsgOption_RAPID_COMMIT = 14,
+			MsgOption_DNS_SERVERS = 23,
+		};
+		enum StatusCodes { // RFC 8415 section 21.13
+			Status_SUCCESS = 0,
+			Status_UNSPEC_FAIL = 1,
+			Status_NO_ADDRS_AVAIL = 2,
+			Status_NO_BINDING = 3,
+			Status_NOT_ON_LINK = 4,
+		};
+
+		struct Option {
+			WORD code;
+			WORD length;
+			const BYTE *pbData; // Into the message buffer
+		};
+
+		// Throws MessageException if the header or any option runs past the end of the datagram
+		DHCPv6Message(const BYTE *pbData, int iDataSize);
+
+		BYTE GetMessageType() const { return messageType; }
+		const BYTE *GetTransactionId() const { return pbTransactionId; } // 3 bytes
+		const std::vector<Option> &GetOptions() const { return options; }
+		const Option *FindOption(WORD code) const;
+
+		// Split an option area (e.g. the options inside an IA_NA) into options
+		static void ParseOptions(const BYTE *pbData, size_t size, std::vector<Option> &options);
+
+	private:
+		BYTE messageType;
+		const BYTE *pbTransactionId;
+		std::vector<Option> options;
+	};
+
+	// DHCPv6 protocol handling for one prefix. Addresses are leased per IA_NA (DUID + IAID) from the
+	// same lease table implementation the DHCPv4 server uses. The engine owns no sockets: it turns
+	// one request into at most one reply for the sender.
+	class DHCPv6Engine {
+	public:
+		typedef LeaseTable<IPv6Address, IPv6AddressHash> LeaseTable6;
+
+		struct LeaseInformation {
+			IPv6Address address;
+			std::vector<BYTE> clientIdentifier; // IAID followed by the client DUID
+			ULONGLONG expireTime; // Server clock seconds; LEASE_NEVER_EXPIRES until acknowledged
+		};
+
+		DHCPv6Engine(DHCPServer::DHCPv6Config config, DHCPServer::ClockFunction clock);
+
+		// Returns false if the request gets no reply (RFC 8415 section 16 discards)
+		bool ProcessRequest(const BYTE *pbData, int iDataSize, std::vector<BYTE> &reply, PacketTrace &trace);
+
+		// Copy of the lease table, safe to call from any thread
+		std::vector<LeaseInformation> GetLeases() const;
+
+		size_t GetLeaseTableMemoryUsage() const { return leaseTable.MemoryUsage(); }
+		ULONGLONG GetReclaimCount() const { return leaseTable.GetReclaimCount(); }
+
+		// DUID-LL (RFC 8415 section 11.4) from the hardware address of the interface with this index
+		static std::vector<BYTE> GetInterfaceDuid(DWORD dwInterfaceIndex);
+
+	private:
+		DHCPServer::DHCPv6Config config;
+		DHCPServer::ClockFunction clock;
+		LeaseTable6 leaseTable;
+		std::vector<DHCPv6Message::Option> vIAOptions; // Reused for the options inside each IA_NA
+		std::vector<BYTE> vLeaseKey; // Reused for IAID + DUID
+
+		bool IsOnLink(const IPv6Address &address) const;
+		LeaseTable6::LeaseHandle Allocate(const std::vector<BYTE> &leaseKey);
+		void AppendIA(std::vector<BYTE> &reply, BYTE messageType, const DHCPv6Message::Option &ia, const DHCPv6Message::Option &clientId);
+	};
+}
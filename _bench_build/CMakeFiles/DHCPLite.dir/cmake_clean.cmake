@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/DHCPLite.dir/main.cpp.o"
+  "CMakeFiles/DHCPLite.dir/main.cpp.o.d"
+  "DHCPLite"
+  "DHCPLite.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/DHCPLite.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,24 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/DHCPLite.cpp" "CMakeFiles/dhcplite.dir/DHCPLite.cpp.o" "gcc" "CMakeFiles/dhcplite.dir/DHCPLite.cpp.o.d"
+  "/root/repo/DHCPSimulator.cpp" "CMakeFiles/dhcplite.dir/DHCPSimulator.cpp.o" "gcc" "CMakeFiles/dhcplite.dir/DHCPSimulator.cpp.o.d"
+  "/root/repo/DHCPTrace.cpp" "CMakeFiles/dhcplite.dir/DHCPTrace.cpp.o" "gcc" "CMakeFiles/dhcplite.dir/DHCPTrace.cpp.o.d"
+  "/root/repo/DHCPv6.cpp" "CMakeFiles/dhcplite.dir/DHCPv6.cpp.o" "gcc" "CMakeFiles/dhcplite.dir/DHCPv6.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_bench_build/CMakeFiles/dhcplite_codec.dir/DependInfo.cmake"
+  "/root/repo/_bench_build/CMakeFiles/dhcplite_allocator.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
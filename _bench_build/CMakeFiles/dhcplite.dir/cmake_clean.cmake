@@ -0,0 +1,17 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/dhcplite.dir/DHCPLite.cpp.o"
+  "CMakeFiles/dhcplite.dir/DHCPLite.cpp.o.d"
+  "CMakeFiles/dhcplite.dir/DHCPSimulator.cpp.o"
+  "CMakeFiles/dhcplite.dir/DHCPSimulator.cpp.o.d"
+  "CMakeFiles/dhcplite.dir/DHCPTrace.cpp.o"
+  "CMakeFiles/dhcplite.dir/DHCPTrace.cpp.o.d"
+  "CMakeFiles/dhcplite.dir/DHCPv6.cpp.o"
+  "CMakeFiles/dhcplite.dir/DHCPv6.cpp.o.d"
+  "libdhcplite.a"
+  "libdhcplite.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/dhcplite.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
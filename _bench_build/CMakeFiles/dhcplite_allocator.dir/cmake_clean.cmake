@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/dhcplite_allocator.dir/DHCPAllocator.cpp.o"
+  "CMakeFiles/dhcplite_allocator.dir/DHCPAllocator.cpp.o.d"
+  "libdhcplite_allocator.a"
+  "libdhcplite_allocator.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/dhcplite_allocator.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/dhcplite_codec.dir/DHCPMessage.cpp.o"
+  "CMakeFiles/dhcplite_codec.dir/DHCPMessage.cpp.o.d"
+  "libdhcplite_codec.a"
+  "libdhcplite_codec.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/dhcplite_codec.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,24 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/bench/DHCPAllocatorBench.cpp" "bench/CMakeFiles/dhcplite_bench.dir/DHCPAllocatorBench.cpp.o" "gcc" "bench/CMakeFiles/dhcplite_bench.dir/DHCPAllocatorBench.cpp.o.d"
+  "/root/repo/bench/DHCPMessageBench.cpp" "bench/CMakeFiles/dhcplite_bench.dir/DHCPMessageBench.cpp.o" "gcc" "bench/CMakeFiles/dhcplite_bench.dir/DHCPMessageBench.cpp.o.d"
+  "/root/repo/bench/DHCPServerBench.cpp" "bench/CMakeFiles/dhcplite_bench.dir/DHCPServerBench.cpp.o" "gcc" "bench/CMakeFiles/dhcplite_bench.dir/DHCPServerBench.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_bench_build/CMakeFiles/dhcplite.dir/DependInfo.cmake"
+  "/root/repo/_bench_build/CMakeFiles/dhcplite_codec.dir/DependInfo.cmake"
+  "/root/repo/_bench_build/CMakeFiles/dhcplite_allocator.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
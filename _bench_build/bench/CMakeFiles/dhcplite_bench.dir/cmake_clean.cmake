@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/dhcplite_bench.dir/DHCPAllocatorBench.cpp.o"
+  "CMakeFiles/dhcplite_bench.dir/DHCPAllocatorBench.cpp.o.d"
+  "CMakeFiles/dhcplite_bench.dir/DHCPMessageBench.cpp.o"
+  "CMakeFiles/dhcplite_bench.dir/DHCPMessageBench.cpp.o.d"
+  "CMakeFiles/dhcplite_bench.dir/DHCPServerBench.cpp.o"
+  "CMakeFiles/dhcplite_bench.dir/DHCPServerBench.cpp.o.d"
+  "dhcplite_bench"
+  "dhcplite_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/dhcplite_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/dhcplite_memory_bench.dir/DHCPLeaseTableMemoryBench.cpp.o"
+  "CMakeFiles/dhcplite_memory_bench.dir/DHCPLeaseTableMemoryBench.cpp.o.d"
+  "dhcplite_memory_bench"
+  "dhcplite_memory_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/dhcplite_memory_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,104 @@
+#include "DHCPAllocator.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+
+using namespace DHCPLite;
+
+namespace {
+	// 10.0.0.0/8 with one pool of dwPoolSize addresses
+	RuntimeConfig MakeRuntimeConfig(DWORD dwPoolSize) {
+		SubnetRuntime subnet{};
+		subnet.dwNetworkValue = 0x0a000000;
+		subnet.dwMaskValue = 0xff000000;
+		subnet.vRanges.emplace_back(0x0a000001, 0x0a000000 + dwPoolSize);
+		subnet.ullRangeSize = dwPoolSize;
+		RuntimeConfig runtimeConfig;
+		runtimeConfig.vSubnets.push_back(subnet);
+		return runtimeConfig;
+	}
+
+	// Locally administered hardware address for client number dwClient
+	struct ClientAddress {
+		BYTE bytes[6];
+
+		explicit ClientAddress(DWORD dwClient) : bytes{ 0x02, 0x00, static_cast<BYTE>(dwClient >> 24), static_cast<BYTE>(dwClient >> 16),
+			static_cast<BYTE>(dwClient >> 8), static_cast<BYTE>(dwClient) } {
+		}
+	};
+
+	AddressAllocator::LeaseHandle Allocate(AddressAllocator &allocator, const RuntimeConfig &runtimeConfig, DWORD dwClient, ULONGLONG ullNow) {
+		const ClientAddress client(dwClient);
+		return allocator.AllocateLease(runtimeConfig, runtimeConfig.vSubnets.front(), client.bytes, sizeof(client.bytes),
+			client.bytes, sizeof(client.bytes), ullNow);
+	}
+}
+
+// Hand out every address of an empty pool, one new client at a time
+static void BM_AllocatePool(benchmark::State &state) {
+	const DWORD dwPoolSize = static_cast<DWORD>(state.range(0));
+	const RuntimeConfig runtimeConfig = MakeRuntimeConfig(dwPoolSize);
+	for (auto _ : state) {
+		state.PauseTiming();
+		auto upLeaseTable = std::make_unique<LeaseTable<DWORD>>();
+		AddressAllocator allocator(*upLeaseTable);
+		state.ResumeTiming();
+
+		for (DWORD dwClient = 0; dwClient < dwPoolSize; dwClient++) {
+			benchmark::DoNotOptimize(Allocate(allocator, runtimeConfig, dwClient, 0));
+		}
+
+		state.PauseTiming();
+		upLeaseTable.reset();
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * dwPoolSize);
+}
+BENCHMARK(BM_AllocatePool)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// New clients arriving at a full pool whose bindings have all expired, so each takes over the least recently seen one
+static void BM_ReclaimLease(benchmark::State &state) {
+	const DWORD dwPoolSize = static_cast<DWORD>(state.range(0));
+	const RuntimeConfig runtimeConfig = MakeRuntimeConfig(dwPoolSize);
+	LeaseTable<DWORD> leaseTable;
+	AddressAllocator allocator(leaseTable);
+	for (DWORD dwClient = 0; dwClient < dwPoolSize; dwClient++) {
+		leaseTable.SetExpireTime(Allocate(allocator, runtimeConfig, dwClient, 0), 1);
+	}
+
+	// Reclaimed leases are offers, stale once LEASE_OFFER_HOLD_SECONDS have passed
+	ULONGLONG ullNow = LEASE_OFFER_HOLD_SECONDS;
+	DWORD dwClient = dwPoolSize;
+	for (auto _ : state) {
+		if (0 == dwClient % dwPoolSize) {
+			ullNow += LEASE_OFFER_HOLD_SECONDS;
+		}
+		const auto lhLease = Allocate(allocator, runtimeConfig, dwClient++, ullNow);
+		if (AddressAllocator::INVALID_LEASE_HANDLE == lhLease) {
+			state.SkipWithError("No stale binding to reclaim.");
+			break;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReclaimLease)->Arg(1 << 10)->Arg(1 << 20);
+
+// New clients arriving at a full pool whose bindings are all current, so every one is turned away
+static void BM_AllocateFromFullPool(benchmark::State &state) {
+	const DWORD dwPoolSize = static_cast<DWORD>(state.range(0));
+	const RuntimeConfig runtimeConfig = MakeRuntimeConfig(dwPoolSize);
+	LeaseTable<DWORD> leaseTable;
+	AddressAllocator allocator(leaseTable);
+	for (DWORD dwClient = 0; dwClient < dwPoolSize; dwClient++) {
+		leaseTable.SetExpireTime(Allocate(allocator, runtimeConfig, dwClient, 0), LEASE_NEVER_EXPIRES - 1);
+	}
+
+	DWORD dwClient = dwPoolSize;
+	for (auto _ : state) {
+		if (AddressAllocator::INVALID_LEASE_HANDLE != Allocate(allocator, runtimeConfig, dwClient++, 1)) {
+			state.SkipWithError("Full pool handed out an address.");
+			break;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AllocateFromFullPool)->Arg(1 << 10)->Arg(1 << 20);
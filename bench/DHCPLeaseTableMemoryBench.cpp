@@ -0,0 +1,109 @@
+#include "DHCPLeaseTable.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <unordered_map>
+
+using namespace DHCPLite;
+
+// Every heap allocation of this executable is counted, so hash map nodes and bucket arrays are measured
+// along with the tables' own arrays. Bytes are counted as requested; malloc's per-block overhead, which
+// the map layout pays once per node, is left out.
+namespace {
+	constexpr size_t ALLOCATION_HEADER_SIZE = alignof(std::max_align_t);
+	std::atomic<size_t> stHeapBytes{ 0 };
+}
+
+void *operator new(size_t stSize) {
+	void *pvBlock = std::malloc(stSize + ALLOCATION_HEADER_SIZE);
+	if (nullptr == pvBlock) {
+		throw std::bad_alloc();
+	}
+	*static_cast<size_t *>(pvBlock) = stSize;
+	stHeapBytes += stSize;
+	return static_cast<BYTE *>(pvBlock) + ALLOCATION_HEADER_SIZE;
+}
+
+void operator delete(void *pvData) noexcept {
+	if (nullptr != pvData) {
+		void *pvBlock = static_cast<BYTE *>(pvData) - ALLOCATION_HEADER_SIZE;
+		stHeapBytes -= *static_cast<size_t *>(pvBlock);
+		std::free(pvBlock);
+	}
+}
+
+void operator delete(void *pvData, size_t) noexcept {
+	operator delete(pvData);
+}
+
+namespace {
+	// The DHCPv4 lease table as it was before the struct-of-arrays layout: one record per lease and a
+	// node-based hash map for each index
+	class MapLeaseTable {
+	public:
+		struct Lease {
+			DWORD address;
+			DWORD dwClientIdentifierOffset;
+			DWORD dwClientIdentifierSize;
+			ULONGLONG ullExpireTime;
+		};
+
+		void Add(DWORD address, const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize) {
+			std::lock_guard<std::mutex> lock(mLeaseTable);
+			Lease lease{ address, static_cast<DWORD>(vClientIdentifiers.size()), dwClientIdentifierSize, LEASE_NEVER_EXPIRES };
+			vClientIdentifiers.insert(vClientIdentifiers.end(), pbClientIdentifier, pbClientIdentifier + dwClientIdentifierSize);
+			const size_t stLease = vLeases.size();
+			vLeases.push_back(lease);
+			mapLeaseByAddress[address] = stLease;
+			mapLeaseByClientIdentifier.emplace(HashClientIdentifier(pbClientIdentifier, dwClientIdentifierSize), stLease);
+		}
+
+	private:
+		std::vector<Lease> vLeases;
+		std::vector<BYTE> vClientIdentifiers;
+		std::unordered_multimap<ULONGLONG, size_t> mapLeaseByClientIdentifier;
+		std::unordered_map<DWORD, size_t> mapLeaseByAddress;
+		std::mutex mLeaseTable;
+	};
+
+	const DWORD BENCH_POOL = 0x0a000000;
+
+	// Fill a table with state.range(0) leases from one pool, 7-byte client identifiers (type and MAC
+	// address) and sequential addresses, and report the heap bytes it holds per lease
+	template <class Table, class AddLease>
+	void MeasureLeaseMemory(benchmark::State &state, AddLease addLease) {
+		const DWORD dwLeases = static_cast<DWORD>(state.range(0));
+		size_t stTableBytes = 0;
+		for (auto _ : state) {
+			const size_t stHeapBytesBefore = stHeapBytes;
+			{
+				Table table;
+				for (DWORD dwLease = 0; dwLease < dwLeases; dwLease++) {
+					const BYTE clientIdentifier[7]{ 1, 0x02, 0x00, static_cast<BYTE>(dwLease >> 24), static_cast<BYTE>(dwLease >> 16),
+						static_cast<BYTE>(dwLease >> 8), static_cast<BYTE>(dwLease) };
+					addLease(table, BENCH_POOL + dwLease, clientIdentifier, static_cast<DWORD>(sizeof(clientIdentifier)));
+				}
+				stTableBytes = stHeapBytes - stHeapBytesBefore;
+				state.PauseTiming();
+			}
+			state.ResumeTiming();
+		}
+		state.counters["leases"] = dwLeases;
+		state.counters["bytes_per_lease"] = static_cast<double>(stTableBytes) / dwLeases;
+	}
+}
+
+static void BM_LeaseMemory_MapLayout(benchmark::State &state) {
+	MeasureLeaseMemory<MapLeaseTable>(state, [](MapLeaseTable &table, DWORD address, const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize) {
+		table.Add(address, pbClientIdentifier, dwClientIdentifierSize);
+	});
+}
+BENCHMARK(BM_LeaseMemory_MapLayout)->Arg(1000000)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+static void BM_LeaseMemory_LeaseTable(benchmark::State &state) {
+	MeasureLeaseMemory<LeaseTable<DWORD>>(state, [](LeaseTable<DWORD> &table, DWORD address, const BYTE *pbClientIdentifier, DWORD dwClientIdentifierSize) {
+		table.Add(address, pbClientIdentifier, dwClientIdentifierSize, true, BENCH_POOL);
+	});
+}
+BENCHMARK(BM_LeaseMemory_LeaseTable)->Arg(1000000)->Iterations(1)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,92 @@
+#include "DHCPMessage.h"
+#include <benchmark/benchmark.h>
+#include <numeric>
+
+using namespace DHCPLite;
+
+namespace {
+	DHCPMessage MakeMessage(DHCPMessage::MessageOpValues op) {
+		DHCPMessage message;
+		message.body.op = op;
+		message.body.htype = 1;
+		message.body.hlen = 6;
+		message.body.xid = 0x12345678;
+		const BYTE chaddr[6]{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+		std::copy(std::begin(chaddr), std::end(chaddr), message.body.chaddr);
+		message.body.magicCookie = *reinterpret_cast<const DWORD *>(MAGIC_COOKIE);
+		return message;
+	}
+
+	// DISCOVER with the options a typical client sends
+	std::vector<BYTE> MakeDiscover() {
+		DHCPMessage message = MakeMessage(DHCPMessage::MsgOp_BOOT_REQUEST);
+		message.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_DISCOVER);
+		message.SetOptionRaw(DHCPMessage::MsgOption_CLIENT_IDENTIFIER, { 1, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 });
+		message.SetOption<DHCPMessage::MsgOption_HOSTNAME>(std::string("workstation-01"));
+		message.SetOption<DHCPMessage::MsgOption_MAX_MESSAGE_SIZE>(htons(1500));
+		message.SetOptionRaw(DHCPMessage::MsgOption_PARAMETER_REQUEST_LIST, { 1, 3, 6, 15, 28, 42, 119, 121 });
+		message.SetOption(DHCPMessage::MsgOption_END);
+		return message.GetData();
+	}
+
+	// ACK carrying a domain search list long enough to be split (RFC 3396)
+	DHCPMessage MakeAck(size_t stSearchListSize) {
+		DHCPMessage message = MakeMessage(DHCPMessage::MsgOp_BOOT_REPLY);
+		message.body.yiaddr = htonl(0x0a000064);
+		message.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_ACK);
+		message.SetOption<DHCPMessage::MsgOption_ADDRESS_LEASETIME>(htonl(60 * 60));
+		message.SetOption<DHCPMessage::MsgOption_SUBNET_MASK>(htonl(0xffffff00));
+		message.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(htonl(0x0a000001));
+		message.SetOption<DHCPMessage::MsgOption_ROUTER>(std::vector<DWORD>{ htonl(0x0a000001) });
+		message.SetOption<DHCPMessage::MsgOption_DOMAIN_NAME_SERVER>(std::vector<DWORD>{ htonl(0x0a000002), htonl(0x0a000003) });
+		if (0 != stSearchListSize) {
+			std::vector<BYTE> searchList(stSearchListSize);
+			std::iota(searchList.begin(), searchList.end(), BYTE{ 1 });
+			message.SetOptionRaw(DHCPMessage::MsgOption_DOMAIN_SEARCH, searchList);
+		}
+		message.SetOption(DHCPMessage::MsgOption_END);
+		return message;
+	}
+}
+
+static void BM_ParseDiscover(benchmark::State &state) {
+	const std::vector<BYTE> data = MakeDiscover();
+	for (auto _ : state) {
+		DHCPMessage message(data);
+		benchmark::DoNotOptimize(message.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	}
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_ParseDiscover);
+
+// Joining the instances of a split option and validating the result
+static void BM_ParseSplitOptions(benchmark::State &state) {
+	const std::vector<BYTE> data = MakeAck(static_cast<size_t>(state.range(0))).GetData();
+	for (auto _ : state) {
+		DHCPMessage message(data);
+		benchmark::DoNotOptimize(message.GetOptionRaw(DHCPMessage::MsgOption_DOMAIN_SEARCH));
+	}
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_ParseSplitOptions)->Arg(0)->Arg(600)->Arg(1020);
+
+static void BM_EncodeAck(benchmark::State &state) {
+	DHCPMessage message = MakeAck(static_cast<size_t>(state.range(0)));
+	size_t stSize = 0;
+	for (auto _ : state) {
+		const std::vector<BYTE> data = message.GetData();
+		stSize = data.size();
+		benchmark::DoNotOptimize(data.data());
+	}
+	state.SetBytesProcessed(state.iterations() * stSize);
+}
+BENCHMARK(BM_EncodeAck)->Arg(0)->Arg(600)->Arg(1020);
+
+// Building the reply from scratch, as the server does for every DISCOVER and REQUEST
+static void BM_BuildAndEncodeAck(benchmark::State &state) {
+	for (auto _ : state) {
+		const std::vector<BYTE> data = MakeAck(0).GetData();
+		benchmark::DoNotOptimize(data.data());
+	}
+}
+BENCHMARK(BM_BuildAndEncodeAck);
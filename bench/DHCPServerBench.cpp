@@ -0,0 +1,120 @@
+#include "DHCPLite.h"
+#include <benchmark/benchmark.h>
+
+using namespace DHCPLite;
+
+namespace {
+	const DWORD SERVER_ADDRESS = 0x0a000001; // Host order
+	const ULONGLONG BENCH_TIME = 1000;
+
+	// Server for 10.0.0.0/8 replying through the in-memory transport, so a request is processed end to end
+	// (parse, lookup, allocate, encode) without touching a socket
+	struct BenchServer {
+		DHCPServer server;
+		ULONGLONG ullReplies = 0;
+
+		BenchServer() {
+			DHCPServer::DHCPConfig config{ { htonl(SERVER_ADDRESS), htonl(0xff000000), 0 }, htonl(0x0a000002), htonl(0x0afffffe) };
+			server.SetClock([] { return BENCH_TIME; });
+			server.SetSendCallback([this](const BYTE *pbData, int, DWORD) {
+				benchmark::DoNotOptimize(pbData);
+				ullReplies++;
+			});
+			server.Init(config);
+		}
+	};
+
+	std::vector<BYTE> MakeRequest(DWORD dwClient, DHCPMessage::MessageTypes messageType, DWORD dwClientAddr = 0) {
+		DHCPMessage message;
+		message.body.op = DHCPMessage::MsgOp_BOOT_REQUEST;
+		message.body.htype = 1;
+		message.body.hlen = 6;
+		message.body.xid = dwClient;
+		message.body.ciaddr = dwClientAddr;
+		const BYTE chaddr[6]{ 0x02, 0x00, static_cast<BYTE>(dwClient >> 24), static_cast<BYTE>(dwClient >> 16),
+			static_cast<BYTE>(dwClient >> 8), static_cast<BYTE>(dwClient) };
+		std::copy(std::begin(chaddr), std::end(chaddr), message.body.chaddr);
+		message.body.magicCookie = *reinterpret_cast<const DWORD *>(MAGIC_COOKIE);
+		message.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(messageType);
+		message.SetOptionRaw(DHCPMessage::MsgOption_PARAMETER_REQUEST_LIST, { 1, 3, 6, 15 });
+		message.SetOption(DHCPMessage::MsgOption_END);
+		return message.GetData();
+	}
+}
+
+// DISCOVER from a client never seen before, answered with an OFFER from a fresh lease
+static void BM_DiscoverNewClient(benchmark::State &state) {
+	BenchServer benchServer;
+	// Encoded up front so only the server is measured; the pool holds 16M addresses, more than a run uses
+	const DWORD dwBatch = 1 << 16;
+	std::vector<std::vector<BYTE>> vRequests;
+	DWORD dwClient = 0;
+	for (auto _ : state) {
+		if (0 == dwClient % dwBatch) {
+			state.PauseTiming();
+			vRequests.clear();
+			for (DWORD i = 0; i < dwBatch; i++) {
+				vRequests.push_back(MakeRequest(dwClient + i, DHCPMessage::MsgType_DISCOVER));
+			}
+			state.ResumeTiming();
+		}
+		const std::vector<BYTE> &request = vRequests[dwClient++ % dwBatch];
+		benchServer.server.ProcessRequest(request.data(), static_cast<int>(request.size()));
+	}
+	if (benchServer.ullReplies != static_cast<ULONGLONG>(state.iterations())) {
+		state.SkipWithError("A DISCOVER got no OFFER.");
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DiscoverNewClient);
+
+// RENEWING clients extending their leases, answered with an ACK
+static void BM_RenewLease(benchmark::State &state) {
+	BenchServer benchServer;
+	const DWORD dwClients = static_cast<DWORD>(state.range(0));
+	std::vector<std::vector<BYTE>> vRequests;
+	for (DWORD dwClient = 0; dwClient < dwClients; dwClient++) {
+		const std::vector<BYTE> discover = MakeRequest(dwClient, DHCPMessage::MsgType_DISCOVER);
+		benchServer.server.ProcessRequest(discover.data(), static_cast<int>(discover.size()));
+	}
+	auto snapshot = benchServer.server.GetLeaseSnapshot();
+	for (DWORD dwClient = 0; dwClient < dwClients; dwClient++) {
+		const std::vector<BYTE> chaddr{ 0x02, 0x00, static_cast<BYTE>(dwClient >> 24), static_cast<BYTE>(dwClient >> 16),
+			static_cast<BYTE>(dwClient >> 8), static_cast<BYTE>(dwClient) };
+		std::vector<BYTE> clientIdentifier(chaddr);
+		clientIdentifier.resize(sizeof(DHCPMessage::MessageBody::chaddr));
+		const auto *pLease = snapshot->FindByClientIdentifier(clientIdentifier);
+		if (nullptr == pLease) {
+			state.SkipWithError("Client has no lease.");
+			return;
+		}
+		vRequests.push_back(MakeRequest(dwClient, DHCPMessage::MsgType_REQUEST, pLease->address));
+	}
+	benchServer.ullReplies = 0;
+
+	size_t stRequest = 0;
+	for (auto _ : state) {
+		const std::vector<BYTE> &request = vRequests[stRequest];
+		benchServer.server.ProcessRequest(request.data(), static_cast<int>(request.size()));
+		stRequest = (stRequest + 1) % vRequests.size();
+	}
+	if (benchServer.ullReplies != static_cast<ULONGLONG>(state.iterations())) {
+		state.SkipWithError("A REQUEST got no ACK.");
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RenewLease)->Arg(1 << 10)->Arg(1 << 18);
+
+// DHCPINFORM, answered from the subnet's pre-encoded reply template
+static void BM_Inform(benchmark::State &state) {
+	BenchServer benchServer;
+	const std::vector<BYTE> request = MakeRequest(1, DHCPMessage::MsgType_INFORM, htonl(0x0a000100));
+	for (auto _ : state) {
+		benchServer.server.ProcessRequest(request.data(), static_cast<int>(request.size()));
+	}
+	if (benchServer.ullReplies != static_cast<ULONGLONG>(state.iterations())) {
+		state.SkipWithError("A DHCPINFORM got no ACK.");
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Inform);
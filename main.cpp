@@ -1,11 +1,18 @@
 #include "DHCPLite.h"
+#include "DHCPSimulator.h"
+#include "DHCPv6.h"
 #include <iostream>
-#include <windows.h>
+#include <iomanip>
+#include <chrono>
+#ifndef _WIN32
+#include <csignal>
+#endif
 
 using namespace DHCPLite;
 
 std::unique_ptr<DHCPServer> server;
 
+#ifdef _WIN32
 BOOL WINAPI ConsoleCtrlHandlerRoutine(DWORD dwCtrlType) {
 	if ((CTRL_C_EVENT == dwCtrlType) || (CTRL_BREAK_EVENT == dwCtrlType)) {
 		server->Close();
@@ -15,16 +22,109 @@ BOOL WINAPI ConsoleCtrlHandlerRoutine(DWORD dwCtrlType) {
 	}
 	return FALSE;
 }
+#else
+void SignalHandlerRoutine(int) {
+	// Runs on the thread blocked in select(); only async-signal-safe calls from here
+	const int iSavedErrno = errno;
+	server->Close();
+	const char pcsMessage[] = "Stopping server request handler.\n";
+	const ssize_t iBytesWritten = write(STDOUT_FILENO, pcsMessage, sizeof(pcsMessage) - 1);
+	(void)iBytesWritten;
+	errno = iSavedErrno;
+}
+
+void ReloadSignalHandlerRoutine(int) {
+	// The request thread reloads once the signal has interrupted its wait
+	server->RequestReload();
+}
+#endif
+
+bool SetShutdownHandler() {
+#ifdef _WIN32
+	return FALSE != SetConsoleCtrlHandler(ConsoleCtrlHandlerRoutine, TRUE);
+#else
+	// No SA_RESTART, so the blocked select() returns EINTR and sees the closed sockets (or the reload request)
+	struct sigaction saShutdown {};
+	saShutdown.sa_handler = SignalHandlerRoutine;
+	sigemptyset(&saShutdown.sa_mask);
+	struct sigaction saReload {};
+	saReload.sa_handler = ReloadSignalHandlerRoutine;
+	sigemptyset(&saReload.sa_mask);
+	return (0 == sigaction(SIGINT, &saShutdown, nullptr)) && (0 == sigaction(SIGTERM, &saShutdown, nullptr))
+		&& (0 == sigaction(SIGHUP, &saReload, nullptr));
+#endif
+}
+
+void Pause() {
+#ifdef _WIN32
+	system("pause");
+#endif
+}
+
+int Simulate(int argc, char **argv) {
+	DHCPSimulator::SimulationConfig simulationConfig;
+	simulationConfig.clientCount = std::stoul(argv[2]);
+	simulationConfig.duration = std::stoull(argv[3]) * 60 * 60;
+	if (argc > 4) {
+		simulationConfig.leaseTime = std::stoul(argv[4]);
+	}
+
+	std::cout << "Simulating " << simulationConfig.clientCount << " clients for " << argv[3] << " hours "
+		<< "(lease time " << simulationConfig.leaseTime << " seconds)\n\n";
+	std::cout << std::setw(5) << "Hour" << std::setw(10) << "Discover" << std::setw(10) << "Request"
+		<< std::setw(10) << "Offer" << std::setw(10) << "ACK" << std::setw(10) << "NAK" << std::setw(7) << "NAK%"
+		<< std::setw(10) << "Drops" << std::setw(10) << "Reclaims" << std::setw(10) << "Bound" << std::setw(7) << "Pool%" << std::setw(11) << "Server ms" << "\n";
+
+	const auto start = std::chrono::steady_clock::now();
+	DHCPSimulator simulator(simulationConfig);
+	const auto hourlyStatistics = simulator.Run([](const DHCPSimulator::HourStatistics &statistics) {
+		const DWORD dwReplies = statistics.acks + statistics.naks;
+		std::cout << std::setw(5) << statistics.hour
+			<< std::setw(10) << statistics.discovers
+			<< std::setw(10) << statistics.requests
+			<< std::setw(10) << statistics.offers
+			<< std::setw(10) << statistics.acks
+			<< std::setw(10) << statistics.naks
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(7) << ((0 != dwReplies) ? (100.0 * statistics.naks / dwReplies) : 0.0)
+			<< std::setw(10) << statistics.drops
+			<< std::setw(10) << statistics.reclaims
+			<< std::setw(10) << statistics.boundClients
+			<< std::setw(7) << (100.0 * statistics.activeLeases / statistics.poolSize)
+			<< std::setw(11) << statistics.serverMilliseconds << "\n";
+	});
+	const double dElapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-int main(int /*argc*/, char ** /*argv*/) {
+	std::cout << "\nSimulated " << simulationConfig.duration << " seconds in " << dElapsedSeconds << " seconds ("
+		<< (simulationConfig.duration / max(dElapsedSeconds, 0.001)) << "x real time)\n";
+	if (!hourlyStatistics.empty() && (0 != hourlyStatistics.back().bindings)) {
+		const auto &lastHour = hourlyStatistics.back();
+		std::cout << "Lease table: " << lastHour.bindings << " bindings in " << lastHour.leaseTableBytes << " bytes ("
+			<< (lastHour.leaseTableBytes / lastHour.bindings) << " bytes per binding)\n";
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
 	std::cout << "DHCPLite\n2016-04-02\n";
 	std::cout << "Copyright (c) 2001-2016 by David Anson (http://dlaa.me/)\n\n";
 
+	if ((argc > 3) && (0 == strcmp(argv[1], "--simulate"))) {
+		// DHCPLite --simulate <clients> <hours> [leaseSeconds]
+		try {
+			return Simulate(argc, argv);
+		}
+		catch (const std::exception &e) {
+			std::cout << "[Error] " << e.what() << "\n";
+			return 1;
+		}
+	}
+
 	server = std::make_unique<DHCPServer>();
 
-	if (!SetConsoleCtrlHandler(ConsoleCtrlHandlerRoutine, TRUE)) {
+	if (!SetShutdownHandler()) {
 		std::cout << "[Error] Unable to set Ctrl-C handler.\n";
-		system("pause");
+		Pause();
 		return 1;
 	}
 
@@ -42,25 +142,55 @@ int main(int /*argc*/, char ** /*argv*/) {
 		std::cout << "Denying client \"" << clientHostName << "\" unoffered IP address.\n";
 	});
 
+	server->SetInformCallback([](char *clientHostName, DWORD clientAddr) {
+		std::cout << "Informing client \"" << clientHostName << "\" "
+			<< "at IP address " << DHCPServer::IPAddrToString(clientAddr) << "\n";
+	});
+
+	server->SetReloadCallback([](const std::string &result) {
+		std::cout << "Reloading configuration: " << result;
+	});
+
 	try {
 		auto config = DHCPServer::GetDHCPConfig();
 
 		std::cout << "IP Address being used:\n"
 			<< DHCPServer::IPAddrToString(config.addrInfo.address)
-			<< " - Subnet:" << DHCPServer::IPAddrToString(config.addrInfo.mask)
-			<< " - Range:[" << DHCPServer::IPAddrToString(config.minAddr)
-			<< "-" << DHCPServer::IPAddrToString(config.maxAddr) << "]\n";
+			<< " - Subnet:" << DHCPServer::IPAddrToString(config.addrInfo.mask);
+		if (argc > 1) {
+			// Optional configuration file replaces the auto-detected range
+			config = DHCPServer::LoadDHCPConfig(argv[1], config);
+			server->SetConfigFile(argv[1]);
+			std::cout << " - Configuration:" << argv[1] << " (" << config.subnets.size() << " subnets)\n";
+		}
+		else {
+			std::cout << " - Range:[" << DHCPServer::IPAddrToString(config.minAddr)
+				<< "-" << DHCPServer::IPAddrToString(config.maxAddr) << "]\n";
+		}
 
 		server->Init(config);
+		if (0 != config.dhcpv6.prefixLength) {
+			std::cout << "DHCPv6 prefix being used:\n" << IPv6AddressToString(config.dhcpv6.prefix)
+				<< "/" << static_cast<int>(config.dhcpv6.prefixLength) << "\n";
+		}
+
+		try {
+			server->StartControl();
+			std::cout << "Lease queries available on 127.0.0.1:" << DHCP_CONTROL_PORT << "\n";
+		}
+		catch (const DHCPException &e) {
+			std::cout << "[Warning] " << e.what() << "\n";
+		}
+
 		std::cout << "Server is running...  (Press Ctrl+C to shutdown.)\n";
 		server->Start();
 	}
-	catch (DHCPException e) {
+	catch (const DHCPException &e) {
 		std::cout << "[Error] " << e.what() << "\n";
 	}
 
 	server->Cleanup();
 
-	system("pause");
+	Pause();
 	return 0;
 }
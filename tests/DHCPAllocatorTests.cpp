@@ -0,0 +1,166 @@
+#include "DHCPAllocator.h"
+#include <gtest/gtest.h>
+
+using namespace DHCPLite;
+
+namespace {
+	typedef std::vector<std::pair<DWORD, DWORD>> Ranges;
+
+	const BYTE HARDWARE_ADDRESS[6]{ 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+
+	SubnetRuntime MakeSubnet(DWORD dwNetworkValue, DWORD dwMaskValue, Ranges ranges) {
+		SubnetRuntime subnet{};
+		subnet.dwNetworkValue = dwNetworkValue;
+		subnet.dwMaskValue = dwMaskValue;
+		subnet.vRanges = std::move(ranges);
+		for (auto &&range : subnet.vRanges) {
+			subnet.ullRangeSize += static_cast<ULONGLONG>(range.second) - range.first + 1;
+		}
+		return subnet;
+	}
+
+	class AllocatorTest : public ::testing::Test {
+	protected:
+		LeaseTable<DWORD> leaseTable;
+		AddressAllocator allocator{ leaseTable };
+		RuntimeConfig runtimeConfig;
+
+		AllocatorTest() {
+			runtimeConfig.vSubnets.push_back(MakeSubnet(0x0a000000, 0xffffff00, { { 0x0a00000a, 0x0a00000c } }));
+			runtimeConfig.vSubnets.push_back(MakeSubnet(0x0a010000, 0xffffff00, { { 0x0a010064, 0x0a010065 } }));
+		}
+
+		const SubnetRuntime &Subnet(size_t stIndex) const {
+			return runtimeConfig.vSubnets[stIndex];
+		}
+
+		// Lease for a client whose identifier is its hardware address with the last octet set to bClient
+		AddressAllocator::LeaseHandle Allocate(const SubnetRuntime &subnet, BYTE bClient, ULONGLONG ullNow = 0) {
+			BYTE hardwareAddress[sizeof(HARDWARE_ADDRESS)];
+			std::copy(std::begin(HARDWARE_ADDRESS), std::end(HARDWARE_ADDRESS), hardwareAddress);
+			hardwareAddress[sizeof(hardwareAddress) - 1] = bClient;
+			return allocator.AllocateLease(runtimeConfig, subnet, hardwareAddress, sizeof(hardwareAddress), hardwareAddress, sizeof(hardwareAddress), ullNow);
+		}
+
+		DWORD AllocateAddress(const SubnetRuntime &subnet) {
+			bool bReserved;
+			const BYTE hardwareAddress[6]{};
+			return allocator.AllocateAddress(runtimeConfig, subnet, hardwareAddress, sizeof(hardwareAddress), false, bReserved);
+		}
+	};
+}
+
+TEST(SubtractRanges, RemovesExclusionsAndMergesRanges) {
+	EXPECT_EQ((Ranges{ { 1, 2 }, { 5, 9 } }), SubtractRanges({ { 1, 10 } }, { { 3, 4 }, { 10, 12 } }));
+	EXPECT_EQ((Ranges{ { 1, 20 } }), SubtractRanges({ { 11, 20 }, { 1, 10 } }, {}));
+	EXPECT_EQ((Ranges{ { 1, 4 }, { 8, 20 } }), SubtractRanges({ { 1, 6 }, { 5, 20 } }, { { 5, 7 } }));
+	EXPECT_TRUE(SubtractRanges({ { 1, 10 } }, { { 0, 20 } }).empty());
+	EXPECT_EQ((Ranges{ { 0xfffffffe, 0xffffffff } }), SubtractRanges({ { 0xfffffffe, 0xffffffff } }, { { 0, 1 } }));
+}
+
+TEST_F(AllocatorTest, FindsSubnetContainingAddress) {
+	EXPECT_EQ(&Subnet(0), FindSubnet(runtimeConfig, 0x0a0000ff));
+	EXPECT_EQ(&Subnet(1), FindSubnet(runtimeConfig, 0x0a010001));
+	EXPECT_EQ(nullptr, FindSubnet(runtimeConfig, 0x0a000100));
+	EXPECT_EQ(nullptr, FindSubnet(runtimeConfig, 0x09ffffff));
+}
+
+TEST_F(AllocatorTest, AllocatesEachAddressOnceUntilExhausted) {
+	for (DWORD dwAddrValue = 0x0a00000a; dwAddrValue <= 0x0a00000c; dwAddrValue++) {
+		const auto lhLease = Allocate(Subnet(0), static_cast<BYTE>(dwAddrValue));
+		ASSERT_NE(AddressAllocator::INVALID_LEASE_HANDLE, lhLease);
+		EXPECT_EQ(dwAddrValue, leaseTable.GetAddress(lhLease));
+	}
+	EXPECT_EQ(3u, leaseTable.GetPoolSize(Subnet(0).dwNetworkValue));
+	// Every binding is an offer still held for its client
+	EXPECT_EQ(AddressAllocator::INVALID_LEASE_HANDLE, Allocate(Subnet(0), 0xff));
+	EXPECT_EQ(0u, AllocateAddress(Subnet(0)));
+
+	// Other subnets are not affected
+	const auto lhLease = Allocate(Subnet(1), 0xff);
+	ASSERT_NE(AddressAllocator::INVALID_LEASE_HANDLE, lhLease);
+	EXPECT_EQ(0x0a010064u, leaseTable.GetAddress(lhLease));
+}
+
+TEST_F(AllocatorTest, ContinuesAfterLastOfferedAddress) {
+	EXPECT_EQ(0x0a00000au, AllocateAddress(Subnet(0)));
+	// Offering an address moves the cursor past it even if no lease is added
+	EXPECT_EQ(0x0a00000bu, AllocateAddress(Subnet(0)));
+	EXPECT_EQ(0x0a00000cu, AllocateAddress(Subnet(0)));
+	// Wraps to the lowest address, skipping those in use
+	leaseTable.Add(0x0a00000a, HARDWARE_ADDRESS, sizeof(HARDWARE_ADDRESS));
+	EXPECT_EQ(0x0a00000bu, AllocateAddress(Subnet(0)));
+
+	// Each subnet has its own cursor
+	EXPECT_EQ(0x0a010064u, AllocateAddress(Subnet(1)));
+}
+
+TEST_F(AllocatorTest, ResumesInRangesChangedByReload) {
+	EXPECT_EQ(0x0a00000au, AllocateAddress(Subnet(0)));
+	EXPECT_EQ(0x0a00000bu, AllocateAddress(Subnet(0)));
+	// The cursor now points outside the subnet's ranges
+	runtimeConfig.vSubnets[0] = MakeSubnet(0x0a000000, 0xffffff00, { { 0x0a000001, 0x0a000001 }, { 0x0a000014, 0x0a000015 } });
+	EXPECT_EQ(0x0a000014u, AllocateAddress(Subnet(0)));
+	EXPECT_EQ(0x0a000015u, AllocateAddress(Subnet(0)));
+	EXPECT_EQ(0x0a000001u, AllocateAddress(Subnet(0)));
+}
+
+TEST_F(AllocatorTest, AppliesReservationsOnTheirOwnSubnetOnly) {
+	runtimeConfig.mapReservations[std::string(std::begin(HARDWARE_ADDRESS), std::end(HARDWARE_ADDRESS))] = 0x0a010005;
+	bool bReserved;
+	EXPECT_EQ(0x0a010005u, allocator.AllocateAddress(runtimeConfig, Subnet(1), HARDWARE_ADDRESS, sizeof(HARDWARE_ADDRESS), true, bReserved));
+	EXPECT_TRUE(bReserved);
+	// The client is on another link, where its reservation does not apply
+	EXPECT_EQ(0x0a00000au, allocator.AllocateAddress(runtimeConfig, Subnet(0), HARDWARE_ADDRESS, sizeof(HARDWARE_ADDRESS), false, bReserved));
+	EXPECT_FALSE(bReserved);
+
+	// Reserved leases stay out of the subnet's pool, so they are never reclaimed
+	const auto lhLease = allocator.AllocateLease(runtimeConfig, Subnet(1), HARDWARE_ADDRESS, sizeof(HARDWARE_ADDRESS),
+		HARDWARE_ADDRESS, sizeof(HARDWARE_ADDRESS), 0);
+	ASSERT_NE(AddressAllocator::INVALID_LEASE_HANDLE, lhLease);
+	EXPECT_EQ(0x0a010005u, leaseTable.GetAddress(lhLease));
+	EXPECT_EQ(0u, leaseTable.GetPoolSize(Subnet(1).dwNetworkValue));
+
+	// A reservation already in use is not handed out twice
+	EXPECT_EQ(0x0a010064u, allocator.AllocateAddress(runtimeConfig, Subnet(1), HARDWARE_ADDRESS, sizeof(HARDWARE_ADDRESS), false, bReserved));
+	EXPECT_FALSE(bReserved);
+}
+
+TEST_F(AllocatorTest, ReclaimsStaleBindingsFromFullPool) {
+	const auto lhFirst = Allocate(Subnet(1), 1, 10);
+	const auto lhSecond = Allocate(Subnet(1), 2, 20);
+	leaseTable.SetExpireTime(lhFirst, 100);
+	leaseTable.SetExpireTime(lhSecond, 100);
+	EXPECT_EQ(AddressAllocator::INVALID_LEASE_HANDLE, Allocate(Subnet(1), 3, 50));
+
+	// Both bindings have expired; the least recently seen goes first
+	EXPECT_EQ(lhFirst, Allocate(Subnet(1), 3, 100));
+	EXPECT_EQ(lhSecond, Allocate(Subnet(1), 4, 100));
+	EXPECT_EQ(2u, leaseTable.GetReclaimCount());
+	EXPECT_EQ(2u, leaseTable.Size());
+}
+
+TEST_F(AllocatorTest, ReclaimsIdleBindingsAfterIdleTime) {
+	runtimeConfig.vSubnets[1].dwIdleReclaimTime = 60;
+	const auto lhLease = Allocate(Subnet(1), 1, 10);
+	Allocate(Subnet(1), 2, 20);
+	leaseTable.SetExpireTime(lhLease, 1000);
+	EXPECT_EQ(AddressAllocator::INVALID_LEASE_HANDLE, Allocate(Subnet(1), 3, 69));
+	EXPECT_EQ(lhLease, Allocate(Subnet(1), 3, 70));
+}
+
+TEST_F(AllocatorTest, AllocatesAddressesReloadTookOutOfThePool) {
+	Allocate(Subnet(1), 1);
+	Allocate(Subnet(1), 2);
+	// A reload moves the subnet's range; both bindings are still in the pool, but neither address can be reclaimed
+	runtimeConfig.vSubnets[1] = MakeSubnet(0x0a010000, 0xffffff00, { { 0x0a0100c8, 0x0a0100c9 } });
+	runtimeConfig.vSubnets[1].ullRangesGeneration = 1;
+	const auto lhLease = Allocate(Subnet(1), 3, 1000);
+	ASSERT_NE(AddressAllocator::INVALID_LEASE_HANDLE, lhLease);
+	EXPECT_EQ(0x0a0100c8u, leaseTable.GetAddress(lhLease));
+	EXPECT_EQ(0u, leaseTable.GetReclaimCount());
+	// The old bindings left the pool, so it counts only the addresses in its new range
+	EXPECT_EQ(1u, leaseTable.GetPoolSize(Subnet(1).dwNetworkValue));
+	EXPECT_NE(AddressAllocator::INVALID_LEASE_HANDLE, Allocate(Subnet(1), 4, 1000));
+	EXPECT_EQ(AddressAllocator::INVALID_LEASE_HANDLE, Allocate(Subnet(1), 5, 1000));
+}
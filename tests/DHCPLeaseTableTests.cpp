@@ -0,0 +1,244 @@
+#include "DHCPLeaseTable.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace DHCPLite;
+
+namespace {
+	// Index over handles 0..n-1, each with its own hash
+	class IndexFixture {
+	public:
+		LeaseIndex index;
+		std::vector<ULONGLONG> vHashes;
+		std::vector<bool> vIndexed;
+
+		void Insert(ULONGLONG ullHash) {
+			const DWORD dwHandle = static_cast<DWORD>(vHashes.size());
+			vHashes.push_back(ullHash);
+			vIndexed.push_back(true);
+			index.Insert(ullHash, dwHandle, dwHandle, [this](DWORD dwIndexed, ULONGLONG &ullIndexedHash) {
+				ullIndexedHash = vHashes[dwIndexed];
+				return static_cast<bool>(vIndexed[dwIndexed]);
+			});
+		}
+
+		void Erase(DWORD dwHandle) {
+			index.Erase(vHashes[dwHandle], dwHandle);
+			vIndexed[dwHandle] = false;
+		}
+
+		DWORD Find(DWORD dwHandle) const {
+			return index.Find(vHashes[dwHandle], [dwHandle](DWORD dwCandidate) { return dwHandle == dwCandidate; });
+		}
+	};
+
+	const DWORD TEST_POOL = 1;
+
+	std::string ClientIdentifier(int i) {
+		return "client-" + std::to_string(i);
+	}
+
+	LeaseTable<DWORD>::LeaseHandle AddLease(LeaseTable<DWORD> &table, DWORD dwAddrValue, const std::string &clientIdentifier, DWORD dwPool = TEST_POOL) {
+		return table.Add(dwAddrValue, reinterpret_cast<const BYTE *>(clientIdentifier.data()), static_cast<DWORD>(clientIdentifier.size()), true, dwPool);
+	}
+
+	LeaseTable<DWORD>::LeaseHandle FindLease(const LeaseTable<DWORD> &table, const std::string &clientIdentifier) {
+		return table.FindByClientIdentifier(reinterpret_cast<const BYTE *>(clientIdentifier.data()), static_cast<DWORD>(clientIdentifier.size()));
+	}
+
+	LeaseTable<DWORD>::LeaseHandle Reclaim(LeaseTable<DWORD> &table, ULONGLONG ullNow, const std::string &clientIdentifier, ULONGLONG ullIdleTime = 0) {
+		return table.Reclaim(TEST_POOL, ullNow, ullIdleTime, reinterpret_cast<const BYTE *>(clientIdentifier.data()), static_cast<DWORD>(clientIdentifier.size()),
+			[](DWORD) { return true; });
+	}
+}
+
+TEST(LeaseIndex, FindsInsertedHandles) {
+	IndexFixture fixture;
+	EXPECT_EQ(LeaseIndex::INVALID_SLOT, fixture.index.Find(1, [](DWORD) { return true; }));
+	for (int i = 0; i < 1000; i++) {
+		fixture.Insert(HashClientIdentifier(reinterpret_cast<const BYTE *>(&i), sizeof(i)));
+	}
+	for (DWORD dwHandle = 0; dwHandle < 1000; dwHandle++) {
+		EXPECT_EQ(dwHandle, fixture.Find(dwHandle));
+	}
+}
+
+TEST(LeaseIndex, ErasedSlotsKeepProbePathsIntact) {
+	// Equal hashes share a probe path, so later entries sit behind the earlier ones
+	IndexFixture fixture;
+	for (int i = 0; i < 40; i++) {
+		fixture.Insert(42);
+	}
+	for (DWORD dwHandle = 0; dwHandle < 40; dwHandle += 2) {
+		fixture.Erase(dwHandle);
+	}
+	for (DWORD dwHandle = 0; dwHandle < 40; dwHandle++) {
+		EXPECT_EQ((0 == dwHandle % 2) ? LeaseIndex::INVALID_SLOT : dwHandle, fixture.Find(dwHandle));
+	}
+
+	// Insert reuses the tombstones
+	const size_t stMemory = fixture.index.MemoryUsage();
+	for (int i = 0; i < 20; i++) {
+		fixture.Insert(42);
+	}
+	EXPECT_EQ(stMemory, fixture.index.MemoryUsage());
+	for (DWORD dwHandle = 40; dwHandle < 60; dwHandle++) {
+		EXPECT_EQ(dwHandle, fixture.Find(dwHandle));
+	}
+}
+
+TEST(LeaseIndex, RebuildDropsErasedHandles) {
+	IndexFixture fixture;
+	for (int i = 0; i < 10; i++) {
+		fixture.Insert(static_cast<ULONGLONG>(i));
+	}
+	fixture.Erase(3);
+	fixture.Erase(7);
+	const size_t stMemory = fixture.index.MemoryUsage();
+	// Growing rebuilds the index from the handles hashOf still reports
+	for (int i = 10; i < 200; i++) {
+		fixture.Insert(static_cast<ULONGLONG>(i));
+	}
+	EXPECT_LT(stMemory, fixture.index.MemoryUsage());
+	for (DWORD dwHandle = 0; dwHandle < 200; dwHandle++) {
+		EXPECT_EQ(((3 == dwHandle) || (7 == dwHandle)) ? LeaseIndex::INVALID_SLOT : dwHandle, fixture.Find(dwHandle));
+	}
+}
+
+TEST(LeaseTable, FindsLeasesByAddressAndClientIdentifier) {
+	LeaseTable<DWORD> table;
+	for (int i = 0; i < 100; i++) {
+		EXPECT_EQ(static_cast<size_t>(i), AddLease(table, 0x0a000000 + i, ClientIdentifier(i)));
+	}
+	EXPECT_EQ(100u, table.Size());
+	EXPECT_EQ(42u, table.FindByAddress(0x0a00002a));
+	EXPECT_EQ(42u, FindLease(table, ClientIdentifier(42)));
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, table.FindByAddress(0x0b000000));
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, FindLease(table, ClientIdentifier(100)));
+
+	// Leases found some other way (e.g. by circuit-id) stay out of the client identifier index
+	const std::string circuitId = "circuit";
+	const auto lhCircuit = table.Add(0x0a000100, reinterpret_cast<const BYTE *>(circuitId.data()), static_cast<DWORD>(circuitId.size()), false);
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, FindLease(table, circuitId));
+	EXPECT_TRUE(table.HasClientIdentifier(lhCircuit, reinterpret_cast<const BYTE *>(circuitId.data()), static_cast<DWORD>(circuitId.size())));
+}
+
+TEST(LeaseTable, ReclaimsLeastRecentlySeenLeaseFirst) {
+	LeaseTable<DWORD> table;
+	const auto lhFirst = AddLease(table, 0x0a000001, ClientIdentifier(1));
+	const auto lhSecond = AddLease(table, 0x0a000002, ClientIdentifier(2));
+	const auto lhThird = AddLease(table, 0x0a000003, ClientIdentifier(3));
+	table.Touch(lhFirst, 10);
+	table.Touch(lhSecond, 20);
+	table.Touch(lhThird, 30);
+	table.Touch(lhFirst, 40); // Seen again, so now the last to go
+	for (auto lhLease : { lhFirst, lhSecond, lhThird }) {
+		table.SetExpireTime(lhLease, 100);
+	}
+	EXPECT_EQ(3u, table.GetPoolSize(TEST_POOL));
+
+	// Nothing has expired yet
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, Reclaim(table, 50, ClientIdentifier(4)));
+
+	EXPECT_EQ(lhSecond, Reclaim(table, 200, ClientIdentifier(4)));
+	EXPECT_EQ(lhThird, Reclaim(table, 200, ClientIdentifier(5)));
+	EXPECT_EQ(lhFirst, Reclaim(table, 200, ClientIdentifier(6)));
+	// Reclaimed leases are fresh offers, held for LEASE_OFFER_HOLD_SECONDS
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, Reclaim(table, 200, ClientIdentifier(7)));
+	EXPECT_EQ(lhSecond, Reclaim(table, 200 + LEASE_OFFER_HOLD_SECONDS, ClientIdentifier(7)));
+
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, FindLease(table, ClientIdentifier(2)));
+	EXPECT_EQ(lhSecond, FindLease(table, ClientIdentifier(7)));
+	EXPECT_EQ(0x0a000002u, table.GetAddress(lhSecond));
+	EXPECT_EQ(LEASE_NEVER_EXPIRES, table.GetExpireTime(lhSecond));
+	EXPECT_EQ(4u, table.GetReclaimCount());
+	EXPECT_EQ(3u, table.GetPoolSize(TEST_POOL));
+}
+
+TEST(LeaseTable, ReclaimsIdleAndRetiredLeases) {
+	LeaseTable<DWORD> table;
+	const auto lhIdle = AddLease(table, 0x0a000001, ClientIdentifier(1));
+	const auto lhRetired = AddLease(table, 0x0a000002, ClientIdentifier(2));
+	table.Touch(lhIdle, 10);
+	table.Touch(lhRetired, 20);
+	table.SetExpireTime(lhIdle, 1000);
+	table.SetExpireTime(lhRetired, 1000);
+
+	// Unexpired bindings are only taken over after the idle time
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, Reclaim(table, 100, ClientIdentifier(3)));
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, Reclaim(table, 100, ClientIdentifier(3), 100));
+	EXPECT_EQ(lhIdle, Reclaim(table, 110, ClientIdentifier(3), 100));
+
+	// A released lease moves to the front regardless of when it was seen
+	table.SetExpireTime(lhRetired, 120);
+	table.Retire(lhRetired);
+	EXPECT_EQ(lhRetired, Reclaim(table, 120, ClientIdentifier(4)));
+}
+
+TEST(LeaseTable, ReclaimDropsUnusableLeasesFromThePool) {
+	LeaseTable<DWORD> table;
+	const auto lhRemoved = AddLease(table, 0x0a000001, ClientIdentifier(1));
+	const auto lhKept = AddLease(table, 0x0a000002, ClientIdentifier(2));
+	table.Touch(lhRemoved, 10);
+	table.Touch(lhKept, 20);
+	const std::string clientIdentifier = ClientIdentifier(3);
+	const auto lhLease = table.Reclaim(TEST_POOL, 1000, 0, reinterpret_cast<const BYTE *>(clientIdentifier.data()), static_cast<DWORD>(clientIdentifier.size()),
+		[](DWORD dwAddrValue) { return 0x0a000001 != dwAddrValue; });
+	EXPECT_EQ(lhKept, lhLease);
+	EXPECT_EQ(1u, table.GetPoolSize(TEST_POOL));
+	// The dropped lease keeps its binding
+	EXPECT_EQ(lhRemoved, FindLease(table, ClientIdentifier(1)));
+}
+
+TEST(LeaseTable, PruneTakesUnusableLeasesOutOfThePool) {
+	LeaseTable<DWORD> table;
+	for (DWORD dwAddrValue = 0x0a000001; dwAddrValue <= 0x0a000004; dwAddrValue++) {
+		AddLease(table, dwAddrValue, ClientIdentifier(dwAddrValue));
+	}
+	table.Prune(TEST_POOL, [](DWORD dwAddrValue) { return 0 == (dwAddrValue % 2); });
+	EXPECT_EQ(2u, table.GetPoolSize(TEST_POOL));
+	// Pruned leases keep their binding but are never reclaimed
+	EXPECT_EQ(0u, FindLease(table, ClientIdentifier(0x0a000001)));
+	EXPECT_EQ(1u, Reclaim(table, 1000, ClientIdentifier(5)));
+	EXPECT_EQ(3u, Reclaim(table, 1000, ClientIdentifier(6)));
+}
+
+TEST(LeaseTable, RemovedLeasesFreeTheirAddressAndClient) {
+	LeaseTable<DWORD> table;
+	const auto lhRemoved = AddLease(table, 0x0a000001, ClientIdentifier(1));
+	AddLease(table, 0x0a000002, ClientIdentifier(2));
+	table.Remove(lhRemoved);
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, table.FindByAddress(0x0a000001));
+	EXPECT_EQ(LeaseTable<DWORD>::INVALID_LEASE_HANDLE, FindLease(table, ClientIdentifier(1)));
+	EXPECT_EQ(1u, table.GetPoolSize(TEST_POOL));
+
+	// The client and the address can be bound again, under a new handle
+	const auto lhLease = AddLease(table, 0x0a000001, ClientIdentifier(1));
+	EXPECT_NE(lhRemoved, lhLease);
+	EXPECT_EQ(lhLease, table.FindByAddress(0x0a000001));
+	EXPECT_EQ(lhLease, FindLease(table, ClientIdentifier(1)));
+
+	std::vector<LeaseTable<DWORD>::Lease> leases;
+	std::vector<BYTE> clientIdentifiers;
+	ULONGLONG ullGeneration;
+	ASSERT_TRUE(table.Copy(~0ULL, leases, clientIdentifiers, ullGeneration));
+	EXPECT_EQ(2u, leases.size());
+}
+
+TEST(LeaseTable, CopiesOnlyChangedTables) {
+	LeaseTable<DWORD> table;
+	AddLease(table, 0x0a000001, ClientIdentifier(1), LeaseTable<DWORD>::NO_POOL);
+	std::vector<LeaseTable<DWORD>::Lease> leases;
+	std::vector<BYTE> clientIdentifiers;
+	ULONGLONG ullGeneration;
+	ASSERT_TRUE(table.Copy(~0ULL, leases, clientIdentifiers, ullGeneration));
+	ASSERT_EQ(1u, leases.size());
+	EXPECT_EQ(ClientIdentifier(1), std::string(clientIdentifiers.begin() + leases[0].dwClientIdentifierOffset,
+		clientIdentifiers.begin() + leases[0].dwClientIdentifierOffset + leases[0].dwClientIdentifierSize));
+	EXPECT_TRUE(leases[0].bClientIdentifierIndexed);
+	EXPECT_FALSE(table.Copy(ullGeneration, leases, clientIdentifiers, ullGeneration));
+
+	table.SetExpireTime(0, 100);
+	EXPECT_TRUE(table.Copy(ullGeneration, leases, clientIdentifiers, ullGeneration));
+	EXPECT_EQ(100u, leases[0].ullExpireTime);
+}
@@ -0,0 +1,152 @@
+#include "DHCPMessage.h"
+#include <gtest/gtest.h>
+#include <numeric>
+
+using namespace DHCPLite;
+
+namespace {
+	DHCPMessage::MessageBody MakeBody() {
+		DHCPMessage::MessageBody body{};
+		body.op = DHCPMessage::MsgOp_BOOT_REQUEST;
+		body.htype = 1;
+		body.hlen = 6;
+		body.xid = 0x12345678;
+		body.magicCookie = *reinterpret_cast<const DWORD *>(MAGIC_COOKIE);
+		return body;
+	}
+
+	// Fixed fields of body followed by a hand-encoded option area
+	std::vector<BYTE> Encode(const DHCPMessage::MessageBody &body, std::vector<BYTE> options) {
+		std::vector<BYTE> data(sizeof(body) + options.size());
+		std::memcpy(data.data(), &body, sizeof(body));
+		std::copy(options.begin(), options.end(), data.begin() + sizeof(body));
+		return data;
+	}
+
+	// Length of each instance of code in an encoded message's option area
+	std::vector<size_t> InstanceLengths(const std::vector<BYTE> &data, BYTE code) {
+		std::vector<size_t> lengths;
+		for (size_t i = sizeof(DHCPMessage::MessageBody); i < data.size();) {
+			if ((DHCPMessage::MsgOption_PAD == data[i]) || (DHCPMessage::MsgOption_END == data[i])) {
+				i++;
+				continue;
+			}
+			if (code == data[i]) {
+				lengths.push_back(data[i + 1]);
+			}
+			i += 2 + data[i + 1];
+		}
+		return lengths;
+	}
+}
+
+TEST(DHCPMessage, RoundTripsBodyAndOptions) {
+	DHCPMessage message;
+	message.body = MakeBody();
+	message.body.flags = htons(0x8000);
+	message.body.giaddr = htonl(0x0a010001);
+	const BYTE chaddr[6]{ 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+	std::copy(std::begin(chaddr), std::end(chaddr), message.body.chaddr);
+	message.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_DISCOVER);
+	message.SetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>(htonl(0xc0000264));
+	message.SetOption<DHCPMessage::MsgOption_HOSTNAME>(std::string("client"));
+	message.SetOption<DHCPMessage::MsgOption_DOMAIN_NAME_SERVER>(std::vector<DWORD>{ htonl(0xc0000201), htonl(0xc0000202) });
+	message.SetOptionRaw(DHCPMessage::MsgOption_PARAMETER_REQUEST_LIST, { 1, 3, 6 });
+	message.SetOption(DHCPMessage::MsgOption_END);
+	const std::vector<BYTE> data = message.GetData();
+
+	DHCPMessage parsed(data);
+	EXPECT_EQ(0, memcmp(&message.body, &parsed.body, sizeof(parsed.body)));
+	EXPECT_EQ(DHCPMessage::MsgType_DISCOVER, parsed.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	EXPECT_EQ(htonl(0xc0000264), parsed.GetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>());
+	EXPECT_EQ("client", parsed.GetOption<DHCPMessage::MsgOption_HOSTNAME>());
+	EXPECT_EQ((std::vector<DWORD>{ htonl(0xc0000201), htonl(0xc0000202) }), parsed.GetOption<DHCPMessage::MsgOption_DOMAIN_NAME_SERVER>());
+	EXPECT_EQ((std::vector<BYTE>{ 1, 3, 6 }), parsed.GetOptionRaw(DHCPMessage::MsgOption_PARAMETER_REQUEST_LIST));
+	EXPECT_EQ(data, parsed.GetData());
+}
+
+TEST(DHCPMessage, RejectsTruncatedMessages) {
+	EXPECT_THROW(DHCPMessage(std::vector<BYTE>(sizeof(DHCPMessage::MessageBody) - 1)), MessageException);
+	// Length byte runs past the end of the message
+	EXPECT_THROW(DHCPMessage(Encode(MakeBody(), { DHCPMessage::MsgOption_HOSTNAME, 8, 'a', 'b' })), MessageException);
+	EXPECT_THROW(DHCPMessage(Encode(MakeBody(), { DHCPMessage::MsgOption_HOSTNAME })), MessageException);
+}
+
+TEST(DHCPMessage, RejectsValuesOutsideTheSchema) {
+	DHCPMessage message;
+	EXPECT_THROW(message.SetOptionRaw(DHCPMessage::MsgOption_SUBNET_MASK, { 255, 255, 255 }), MessageException);
+	EXPECT_THROW(message.SetOptionRaw(DHCPMessage::MsgOption_ROUTER, { 10, 0, 0, 1, 10 }), MessageException);
+	// Options that cannot be split are limited to one instance
+	EXPECT_THROW(message.SetOptionRaw(DHCPMessage::MsgOption_HOSTNAME, std::vector<BYTE>(MAX_OPTION_LENGTH + 1, 'a')), MessageException);
+}
+
+TEST(DHCPMessage, SplitsLongOptions) {
+	std::vector<BYTE> searchList(600);
+	std::iota(searchList.begin(), searchList.end(), BYTE{ 0 });
+	DHCPMessage message;
+	message.body = MakeBody();
+	message.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(DHCPMessage::MsgType_ACK);
+	message.SetOptionRaw(DHCPMessage::MsgOption_DOMAIN_SEARCH, searchList);
+	message.SetOption(DHCPMessage::MsgOption_END);
+	const std::vector<BYTE> data = message.GetData();
+
+	EXPECT_EQ((std::vector<size_t>{ 255, 255, 90 }), InstanceLengths(data, DHCPMessage::MsgOption_DOMAIN_SEARCH));
+	EXPECT_EQ(searchList, DHCPMessage(data).GetOptionRaw(DHCPMessage::MsgOption_DOMAIN_SEARCH));
+}
+
+TEST(DHCPMessage, JoinsSplitOptions) {
+	// A router list split in the middle of an address is only valid once joined (RFC 3396 section 7)
+	DHCPMessage message(Encode(MakeBody(), {
+		DHCPMessage::MsgOption_ROUTER, 3, 10, 0, 0,
+		DHCPMessage::MsgOption_MESSAGE_TYPE, 1, DHCPMessage::MsgType_REQUEST,
+		DHCPMessage::MsgOption_ROUTER, 5, 1, 10, 0, 0, 2,
+		DHCPMessage::MsgOption_END }));
+	EXPECT_EQ((std::vector<BYTE>{ 10, 0, 0, 1, 10, 0, 0, 2 }), message.GetOptionRaw(DHCPMessage::MsgOption_ROUTER));
+
+	// Joined values are checked against the schema as a whole
+	DHCPMessage malformed(Encode(MakeBody(), {
+		DHCPMessage::MsgOption_ROUTER, 4, 10, 0, 0, 1,
+		DHCPMessage::MsgOption_ROUTER, 2, 10, 0,
+		DHCPMessage::MsgOption_END }));
+	EXPECT_TRUE(malformed.GetOptionRaw(DHCPMessage::MsgOption_ROUTER).empty());
+}
+
+TEST(DHCPMessage, KeepsFirstInstanceOfUnsplitOptions) {
+	DHCPMessage message(Encode(MakeBody(), {
+		DHCPMessage::MsgOption_HOSTNAME, 5, 'f', 'i', 'r', 's', 't',
+		DHCPMessage::MsgOption_HOSTNAME, 6, 's', 'e', 'c', 'o', 'n', 'd',
+		DHCPMessage::MsgOption_END }));
+	EXPECT_EQ("first", message.GetOption<DHCPMessage::MsgOption_HOSTNAME>());
+
+	// A malformed instance is dropped, so a later well-formed one is used
+	DHCPMessage malformed(Encode(MakeBody(), {
+		DHCPMessage::MsgOption_SUBNET_MASK, 3, 255, 255, 255,
+		DHCPMessage::MsgOption_SUBNET_MASK, 4, 255, 255, 0, 0,
+		DHCPMessage::MsgOption_END }));
+	EXPECT_EQ((std::vector<BYTE>{ 255, 255, 0, 0 }), malformed.GetOptionRaw(DHCPMessage::MsgOption_SUBNET_MASK));
+}
+
+TEST(DHCPMessage, ReadsOverloadedFields) {
+	DHCPMessage::MessageBody body = MakeBody();
+	const BYTE fileOptions[]{ DHCPMessage::MsgOption_HOSTNAME, 4, 'f', 'i', 'l', 'e', DHCPMessage::MsgOption_ROUTER, 2, 10, 0, DHCPMessage::MsgOption_END };
+	std::copy(std::begin(fileOptions), std::end(fileOptions), body.file);
+	DHCPMessage message(Encode(body, {
+		DHCPMessage::MsgOption_OPTION_OVERLOAD, 1, DHCPMessage::MsgOverload_FILE,
+		DHCPMessage::MsgOption_ROUTER, 2, 0, 1,
+		DHCPMessage::MsgOption_END }));
+	EXPECT_EQ("file", message.GetOption<DHCPMessage::MsgOption_HOSTNAME>());
+	// Instances in the options field come before those in the file field (RFC 3396 section 6)
+	EXPECT_EQ((std::vector<BYTE>{ 0, 1, 10, 0 }), message.GetOptionRaw(DHCPMessage::MsgOption_ROUTER));
+}
+
+TEST(DHCPMessage, SplitsRelayAgentInformation) {
+	DHCPMessage message(Encode(MakeBody(), {
+		DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION, 10,
+		DHCPMessage::RelaySubOption_CIRCUIT_ID, 2, 0xaa, 0xbb,
+		9, 0,
+		DHCPMessage::RelaySubOption_REMOTE_ID, 2, 0xcc, 0xdd,
+		DHCPMessage::MsgOption_END }));
+	const auto information = message.GetRelayAgentInformation();
+	EXPECT_EQ((std::vector<BYTE>{ 0xaa, 0xbb }), information.circuitId);
+	EXPECT_EQ((std::vector<BYTE>{ 0xcc, 0xdd }), information.remoteId);
+}
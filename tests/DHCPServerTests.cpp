@@ -0,0 +1,474 @@
+#include "DHCPLite.h"
+#include "DHCPv6.h"
+#include <gtest/gtest.h>
+
+using namespace DHCPLite;
+
+namespace {
+	DWORD Address(const char *pcsAddress) {
+		DWORD dwAddr;
+		inet_pton(AF_INET, pcsAddress, &dwAddr);
+		return dwAddr;
+	}
+
+	const BYTE HARDWARE_ADDRESS[6]{ 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+	const BYTE CIRCUIT_ID[3]{ 0x0a, 0x0b, 0x0c };
+	const std::vector<BYTE> SERVER_DUID{ 0x00, 0x03, 0x00, 0x01, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+	const std::vector<BYTE> CLIENT_DUID{ 0x00, 0x03, 0x00, 0x01, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+
+	// Relay Agent Information option data with a circuit-id and a remote-id sub-option (RFC 3046 section 2.0)
+	std::vector<BYTE> RelayAgentInformation(const BYTE (&circuitId)[3]) {
+		std::vector<BYTE> data{ 1, sizeof(circuitId) };
+		data.insert(data.end(), std::begin(circuitId), std::end(circuitId));
+		data.insert(data.end(), { 2, 2, 0xbe, 0xef });
+		return data;
+	}
+
+	void AppendOption6(std::vector<BYTE> &data, WORD code, const std::vector<BYTE> &value) {
+		data.insert(data.end(), { static_cast<BYTE>(code >> 8), static_cast<BYTE>(code), static_cast<BYTE>(value.size() >> 8), static_cast<BYTE>(value.size()) });
+		data.insert(data.end(), value.begin(), value.end());
+	}
+
+	// DHCPv6 request from CLIENT_DUID for one IA_NA (IAID 1) asking for DNS servers
+	std::vector<BYTE> MakeRequest6(DHCPv6Message::MessageTypes messageType, bool bServerId) {
+		std::vector<BYTE> data{ static_cast<BYTE>(messageType), 0xab, 0xcd, 0xef };
+		AppendOption6(data, DHCPv6Message::MsgOption_CLIENTID, CLIENT_DUID);
+		if (bServerId) {
+			AppendOption6(data, DHCPv6Message::MsgOption_SERVERID, SERVER_DUID);
+		}
+		AppendOption6(data, DHCPv6Message::MsgOption_IA_NA, { 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 }); // IAID, T1, T2
+		AppendOption6(data, DHCPv6Message::MsgOption_ORO, { 0, DHCPv6Message::MsgOption_DNS_SERVERS });
+		return data;
+	}
+
+	// Address in the IA_NA of a DHCPv6 reply, or an unspecified address if the IA_NA has none
+	IPv6Address GetIAAddress(const DHCPv6Message &message) {
+		IPv6Address address{};
+		const DHCPv6Message::Option *pIA = message.FindOption(DHCPv6Message::MsgOption_IA_NA);
+		if ((nullptr != pIA) && (12 <= pIA->length)) {
+			std::vector<DHCPv6Message::Option> iaOptions;
+			DHCPv6Message::ParseOptions(pIA->pbData + 12, pIA->length - 12, iaOptions);
+			for (auto &&option : iaOptions) {
+				if ((DHCPv6Message::MsgOption_IAADDR == option.code) && (address.size() <= option.length)) {
+					std::copy_n(option.pbData, address.size(), address.begin());
+				}
+			}
+		}
+		return address;
+	}
+
+	// Server on 192.0.2.2 serving its own subnet and one relayed subnet, replying through the in-memory transport
+	class ServerTest : public ::testing::Test {
+	protected:
+		DHCPServer server;
+		DHCPServer::DHCPConfig config{ { Address("192.0.2.2"), Address("255.255.255.0"), 0 }, Address("192.0.2.10"), Address("192.0.2.20") };
+		std::vector<DHCPMessage> replies;
+		std::vector<DWORD> replyAddresses; // Destination of each reply
+		ULONGLONG ullNow = 1000;
+
+		ServerTest() {
+			config.subnets.push_back({ Address("192.0.2.0"), Address("255.255.255.0"), { { Address("192.0.2.100"), Address("192.0.2.110") } } });
+			config.subnets.push_back({ Address("10.1.0.0"), Address("255.255.255.0"), { { Address("10.1.0.100"), Address("10.1.0.110") } } });
+			Attach(server);
+		}
+
+		void Attach(DHCPServer &target) {
+			target.SetClock([this] { return ullNow; });
+			target.SetSendCallback([this](const BYTE *pbData, int iDataSize, DWORD dwAddr) {
+				replies.emplace_back(DHCPMessage::PByteToVByte(pbData, iDataSize));
+				replyAddresses.push_back(dwAddr);
+			});
+		}
+
+		DHCPMessage MakeRequest(DHCPMessage::MessageTypes messageType, DWORD dwGatewayAddr = 0) {
+			DHCPMessage message;
+			message.body.op = DHCPMessage::MsgOp_BOOT_REQUEST;
+			message.body.htype = 1;
+			message.body.hlen = sizeof(HARDWARE_ADDRESS);
+			message.body.xid = 0x12345678;
+			message.body.giaddr = dwGatewayAddr;
+			std::copy(std::begin(HARDWARE_ADDRESS), std::end(HARDWARE_ADDRESS), message.body.chaddr);
+			message.body.magicCookie = *reinterpret_cast<const DWORD *>(MAGIC_COOKIE);
+			message.SetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>(messageType);
+			return message;
+		}
+
+		// Reply to the request, or nullptr if there was none
+		const DHCPMessage *Process(DHCPMessage request) {
+			return Process(server, std::move(request));
+		}
+
+		const DHCPMessage *Process(DHCPServer &target, DHCPMessage request) {
+			request.SetOption(DHCPMessage::MsgOption_END);
+			const std::vector<BYTE> data = request.GetData();
+			replies.clear();
+			replyAddresses.clear();
+			target.ProcessRequest(data.data(), static_cast<int>(data.size()));
+			return replies.empty() ? nullptr : &replies.back();
+		}
+
+		// DISCOVER and REQUEST through to an ACK, returning the address acknowledged
+		DWORD Bind(DWORD dwGatewayAddr = 0) {
+			const DHCPMessage *pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, dwGatewayAddr));
+			if (nullptr == pOffer) return 0;
+			const DWORD dwOfferAddr = pOffer->body.yiaddr;
+			DHCPMessage request = MakeRequest(DHCPMessage::MsgType_REQUEST, dwGatewayAddr);
+			request.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(Address("192.0.2.2"));
+			request.SetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>(dwOfferAddr);
+			const DHCPMessage *pAcknowledgement = Process(request);
+			if (nullptr == pAcknowledgement) return 0;
+			DHCPMessage acknowledgement = *pAcknowledgement;
+			return (DHCPMessage::MsgType_ACK == acknowledgement.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>()) ? acknowledgement.body.yiaddr : 0;
+		}
+	};
+}
+
+TEST_F(ServerTest, OffersAndAcknowledgesAnAddress) {
+	ASSERT_TRUE(server.Init(config));
+
+	const DHCPMessage *pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER));
+	ASSERT_NE(nullptr, pOffer);
+	DHCPMessage offer = *pOffer;
+	EXPECT_EQ(DHCPMessage::MsgType_OFFER, offer.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	EXPECT_EQ(Address("192.0.2.100"), offer.body.yiaddr);
+	EXPECT_EQ(0x12345678u, offer.body.xid);
+	EXPECT_EQ(Address("192.0.2.2"), offer.GetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>());
+	EXPECT_EQ(Address("255.255.255.0"), offer.GetOption<DHCPMessage::MsgOption_SUBNET_MASK>());
+
+	DHCPMessage request = MakeRequest(DHCPMessage::MsgType_REQUEST);
+	request.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(Address("192.0.2.2"));
+	request.SetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>(offer.body.yiaddr);
+	const DHCPMessage *pAcknowledgement = Process(request);
+	ASSERT_NE(nullptr, pAcknowledgement);
+	DHCPMessage acknowledgement = *pAcknowledgement;
+	EXPECT_EQ(DHCPMessage::MsgType_ACK, acknowledgement.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	EXPECT_EQ(Address("192.0.2.100"), acknowledgement.body.yiaddr);
+	EXPECT_EQ(htonl(60 * 60), acknowledgement.GetOption<DHCPMessage::MsgOption_ADDRESS_LEASETIME>());
+
+	auto snapshot = server.GetLeaseSnapshot();
+	const auto *pLease = snapshot->FindByAddress(Address("192.0.2.100"));
+	ASSERT_NE(nullptr, pLease);
+	EXPECT_EQ(ullNow + 60 * 60, pLease->expireTime);
+	EXPECT_FALSE(pLease->circuit);
+
+	// A client seen before is offered the same address again
+	pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("192.0.2.100"), pOffer->body.yiaddr);
+}
+
+TEST_F(ServerTest, ServesTheRelayAgentsSubnet) {
+	ASSERT_TRUE(server.Init(config));
+	const DHCPMessage *pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.1.0.1")));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("10.1.0.100"), pOffer->body.yiaddr);
+	EXPECT_EQ(Address("10.1.0.1"), pOffer->body.giaddr);
+
+	// Relay agents on links we do not serve get no reply
+	EXPECT_EQ(nullptr, Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.2.0.1"))));
+}
+
+TEST_F(ServerTest, ServesClientsThatMoveToAnotherSubnetAsNewClients) {
+	ASSERT_TRUE(server.Init(config));
+	const DHCPMessage *pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("192.0.2.100"), pOffer->body.yiaddr);
+
+	// The client now sits behind the relay agent for 10.1.0.0/24, where its old address is off-link
+	DHCPMessage request = MakeRequest(DHCPMessage::MsgType_REQUEST, Address("10.1.0.1"));
+	request.SetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>(Address("192.0.2.100"));
+	const DHCPMessage *pReply = Process(request);
+	ASSERT_NE(nullptr, pReply);
+	DHCPMessage reply = *pReply;
+	EXPECT_EQ(DHCPMessage::MsgType_NAK, reply.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+
+	pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.1.0.1")));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("10.1.0.100"), pOffer->body.yiaddr);
+	request = MakeRequest(DHCPMessage::MsgType_REQUEST, Address("10.1.0.1"));
+	request.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(Address("192.0.2.2"));
+	request.SetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>(Address("10.1.0.100"));
+	pReply = Process(request);
+	ASSERT_NE(nullptr, pReply);
+	reply = *pReply;
+	EXPECT_EQ(DHCPMessage::MsgType_ACK, reply.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	EXPECT_EQ(Address("10.1.0.100"), reply.body.yiaddr);
+
+	// The old binding is gone, leaving its address free for other clients on the local subnet
+	auto snapshot = server.GetLeaseSnapshot();
+	EXPECT_EQ(nullptr, snapshot->FindByAddress(Address("192.0.2.100")));
+	ASSERT_NE(nullptr, snapshot->FindByAddress(Address("10.1.0.100")));
+	EXPECT_EQ(ullNow + 60 * 60, snapshot->FindByAddress(Address("10.1.0.100"))->expireTime);
+}
+
+TEST_F(ServerTest, AppliesReservationsOnTheirOwnSubnetOnly) {
+	config.reservations.push_back({ std::vector<BYTE>(std::begin(HARDWARE_ADDRESS), std::end(HARDWARE_ADDRESS)), Address("10.1.0.10") });
+	ASSERT_TRUE(server.Init(config));
+	const DHCPMessage *pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("192.0.2.100"), pOffer->body.yiaddr);
+
+	// Same client behind the relay agent on the reservation's subnet, with no lease yet
+	DHCPServer relayedServer;
+	Attach(relayedServer);
+	ASSERT_TRUE(relayedServer.Init(config));
+	pOffer = Process(relayedServer, MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.1.0.1")));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("10.1.0.10"), pOffer->body.yiaddr);
+}
+
+TEST_F(ServerTest, DropsMalformedRequests) {
+	ASSERT_TRUE(server.Init(config));
+	const BYTE truncated[16]{};
+	EXPECT_FALSE(server.ProcessRequest(truncated, sizeof(truncated)));
+	EXPECT_TRUE(replies.empty());
+	EXPECT_EQ(1u, server.GetPacketStatistics().dropped);
+}
+
+TEST_F(ServerTest, EndsTheLeaseButKeepsTheBindingOnRelease) {
+	ASSERT_TRUE(server.Init(config));
+	const DWORD dwAddr = Bind();
+	ASSERT_EQ(Address("192.0.2.100"), dwAddr);
+	ullNow += 600;
+
+	// A RELEASE for an address the client does not hold changes nothing
+	DHCPMessage release = MakeRequest(DHCPMessage::MsgType_RELEASE);
+	release.body.ciaddr = Address("192.0.2.101");
+	EXPECT_EQ(nullptr, Process(release));
+	EXPECT_EQ(1000u + 60 * 60, server.GetLeaseSnapshot()->FindByAddress(dwAddr)->expireTime);
+
+	// RELEASE is never answered
+	release.body.ciaddr = dwAddr;
+	EXPECT_EQ(nullptr, Process(release));
+	auto snapshot = server.GetLeaseSnapshot();
+	const auto *pLease = snapshot->FindByAddress(dwAddr);
+	ASSERT_NE(nullptr, pLease);
+	EXPECT_EQ(ullNow, pLease->expireTime);
+
+	// The binding is kept, so the client is offered its address again
+	const DHCPMessage *pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(dwAddr, pOffer->body.yiaddr);
+}
+
+TEST_F(ServerTest, AnswersInformFromTheSubnetTemplate) {
+	config.subnets[0].options[DHCPMessage::MsgOption_ROUTER] = { 192, 0, 2, 1 };
+	ASSERT_TRUE(server.Init(config));
+	const size_t stLeases = server.GetLeaseSnapshot()->GetLeases().size();
+
+	DHCPMessage inform = MakeRequest(DHCPMessage::MsgType_INFORM);
+	inform.body.ciaddr = Address("192.0.2.50");
+	const DHCPMessage *pReply = Process(inform);
+	ASSERT_NE(nullptr, pReply);
+	DHCPMessage reply = *pReply;
+	EXPECT_EQ(DHCPMessage::MsgType_ACK, reply.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	EXPECT_EQ(0x12345678u, reply.body.xid);
+	EXPECT_EQ(Address("192.0.2.50"), reply.body.ciaddr);
+	EXPECT_EQ(0u, reply.body.yiaddr);
+	EXPECT_TRUE(std::equal(std::begin(HARDWARE_ADDRESS), std::end(HARDWARE_ADDRESS), reply.body.chaddr));
+	EXPECT_EQ(Address("192.0.2.2"), reply.GetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>());
+	EXPECT_EQ(Address("255.255.255.0"), reply.GetOption<DHCPMessage::MsgOption_SUBNET_MASK>());
+	EXPECT_EQ(std::vector<BYTE>({ 192, 0, 2, 1 }), reply.GetOptionRaw(DHCPMessage::MsgOption_ROUTER));
+	// RFC 2131 section 3.4 - no lease time, and the ACK is unicast to the client
+	EXPECT_TRUE(reply.GetOptionRaw(DHCPMessage::MsgOption_ADDRESS_LEASETIME).empty());
+	EXPECT_EQ(Address("192.0.2.50"), replyAddresses.back());
+
+	// Relayed: the relay agent's subnet answers, through the relay agent, with its information echoed
+	inform = MakeRequest(DHCPMessage::MsgType_INFORM, Address("10.1.0.1"));
+	inform.body.ciaddr = Address("10.1.0.50");
+	inform.SetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION, RelayAgentInformation(CIRCUIT_ID));
+	pReply = Process(inform);
+	ASSERT_NE(nullptr, pReply);
+	reply = *pReply;
+	EXPECT_EQ(DHCPMessage::MsgType_ACK, reply.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	EXPECT_TRUE(reply.GetOptionRaw(DHCPMessage::MsgOption_ROUTER).empty());
+	EXPECT_EQ(RelayAgentInformation(CIRCUIT_ID), reply.GetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION));
+	EXPECT_EQ(Address("10.1.0.1"), replyAddresses.back());
+	EXPECT_NE(0, reply.body.flags & BROADCAST_FLAG);
+
+	// No address is allocated for either
+	EXPECT_EQ(stLeases, server.GetLeaseSnapshot()->GetLeases().size());
+}
+
+TEST_F(ServerTest, EchoesRelayAgentInformationAndAppliesCircuitPolicies) {
+	config.circuitPolicies.push_back({ std::vector<BYTE>(std::begin(CIRCUIT_ID), std::end(CIRCUIT_ID)), Address("10.1.0.20") });
+	ASSERT_TRUE(server.Init(config));
+	auto snapshot = server.GetLeaseSnapshot();
+	ASSERT_NE(nullptr, snapshot->FindByAddress(Address("10.1.0.20")));
+	EXPECT_TRUE(snapshot->FindByAddress(Address("10.1.0.20"))->circuit);
+
+	// Any client on the circuit gets the circuit's address, and option 82 comes back verbatim
+	DHCPMessage discover = MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.1.0.1"));
+	discover.SetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION, RelayAgentInformation(CIRCUIT_ID));
+	const DHCPMessage *pOffer = Process(discover);
+	ASSERT_NE(nullptr, pOffer);
+	DHCPMessage offer = *pOffer;
+	EXPECT_EQ(Address("10.1.0.20"), offer.body.yiaddr);
+	EXPECT_EQ(RelayAgentInformation(CIRCUIT_ID), offer.GetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION));
+	EXPECT_EQ(Address("10.1.0.1"), replyAddresses.back());
+
+	DHCPMessage request = MakeRequest(DHCPMessage::MsgType_REQUEST, Address("10.1.0.1"));
+	request.SetOption<DHCPMessage::MsgOption_SERVER_IDENTIFIER>(Address("192.0.2.2"));
+	request.SetOption<DHCPMessage::MsgOption_REQUESTED_ADDRESS>(Address("10.1.0.20"));
+	request.SetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION, RelayAgentInformation(CIRCUIT_ID));
+	const DHCPMessage *pReply = Process(request);
+	ASSERT_NE(nullptr, pReply);
+	DHCPMessage reply = *pReply;
+	EXPECT_EQ(DHCPMessage::MsgType_ACK, reply.GetOption<DHCPMessage::MsgOption_MESSAGE_TYPE>());
+	EXPECT_EQ(Address("10.1.0.20"), reply.body.yiaddr);
+	EXPECT_EQ(RelayAgentInformation(CIRCUIT_ID), reply.GetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION));
+
+	// Another circuit on the same relay agent is served from the pool
+	const BYTE otherCircuitId[3]{ 0x0d, 0x0e, 0x0f };
+	discover.SetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION, RelayAgentInformation(otherCircuitId));
+	discover.body.chaddr[5] = 0x56;
+	pOffer = Process(discover);
+	ASSERT_NE(nullptr, pOffer);
+	offer = *pOffer;
+	EXPECT_EQ(Address("10.1.0.100"), offer.body.yiaddr);
+	EXPECT_EQ(RelayAgentInformation(otherCircuitId), offer.GetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION));
+
+	// The circuit-id behind a relay agent on another subnet does not get the address reserved for it
+	discover = MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("192.0.2.1"));
+	discover.SetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION, RelayAgentInformation(CIRCUIT_ID));
+	discover.body.chaddr[5] = 0x57;
+	pOffer = Process(discover);
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("192.0.2.100"), pOffer->body.yiaddr);
+
+	// Unrelayed requests carry no option 82 in their replies
+	pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER));
+	ASSERT_NE(nullptr, pOffer);
+	offer = *pOffer;
+	EXPECT_TRUE(offer.GetOptionRaw(DHCPMessage::MsgOption_RELAY_AGENT_INFORMATION).empty());
+}
+
+TEST_F(ServerTest, ServesTheSubnetsOfAReloadedConfiguration) {
+	ASSERT_TRUE(server.Init(config));
+	ASSERT_EQ(Address("10.1.0.100"), Bind(Address("10.1.0.1")));
+
+	// Move the relayed subnet's pool and add a subnet behind another relay agent
+	DHCPServer::DHCPConfig reloaded = config;
+	reloaded.subnets[1].pools = { { Address("10.1.0.200"), Address("10.1.0.200") } };
+	reloaded.subnets.push_back({ Address("10.2.0.0"), Address("255.255.255.0"), { { Address("10.2.0.100"), Address("10.2.0.110") } } });
+	EXPECT_EQ(nullptr, Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.2.0.1"))));
+	ASSERT_TRUE(server.Reload(reloaded));
+
+	// The existing lease is kept, even though its address left the pool
+	EXPECT_EQ(Address("10.1.0.100"), Bind(Address("10.1.0.1")));
+
+	// New clients get the new pool, and nothing more once it is used up
+	DHCPMessage discover = MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.1.0.1"));
+	discover.body.chaddr[5] = 0x56;
+	const DHCPMessage *pOffer = Process(discover);
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("10.1.0.200"), pOffer->body.yiaddr);
+	discover.body.chaddr[5] = 0x57;
+	EXPECT_EQ(nullptr, Process(discover));
+
+	pOffer = Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.2.0.1")));
+	ASSERT_NE(nullptr, pOffer);
+	EXPECT_EQ(Address("10.2.0.100"), pOffer->body.yiaddr);
+	EXPECT_EQ(Address("10.2.0.1"), replyAddresses.back());
+
+	// Dropping a subnet stops it being served
+	reloaded.subnets.pop_back();
+	ASSERT_TRUE(server.Reload(reloaded));
+	EXPECT_EQ(nullptr, Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.2.0.1"))));
+
+	// Circuit policies apply at Init only, so a reload changing them says so
+	reloaded.circuitPolicies.push_back({ std::vector<BYTE>(std::begin(CIRCUIT_ID), std::end(CIRCUIT_ID)), Address("10.1.0.20") });
+	EXPECT_FALSE(server.Reload(reloaded));
+	EXPECT_EQ(nullptr, server.GetLeaseSnapshot()->FindByAddress(Address("10.1.0.20")));
+}
+
+TEST_F(ServerTest, AssignsDHCPv6Addresses) {
+	StringToIPv6Address("2001:db8:1:2::", config.dhcpv6.prefix);
+	config.dhcpv6.prefixLength = 64;
+	config.dhcpv6.serverDuid = SERVER_DUID;
+	config.dhcpv6.dnsServers.resize(1);
+	StringToIPv6Address("2001:db8:1:2::53", config.dhcpv6.dnsServers[0]);
+	ASSERT_TRUE(server.Init(config));
+
+	std::vector<BYTE> reply;
+	std::vector<BYTE> request = MakeRequest6(DHCPv6Message::MsgType_SOLICIT, false);
+	ASSERT_TRUE(server.ProcessRequest6(request.data(), static_cast<int>(request.size()), reply));
+	ASSERT_FALSE(reply.empty());
+	const DHCPv6Message advertise(reply.data(), static_cast<int>(reply.size()));
+	EXPECT_EQ(DHCPv6Message::MsgType_ADVERTISE, advertise.GetMessageType());
+	EXPECT_TRUE(std::equal(request.begin() + 1, request.begin() + 4, advertise.GetTransactionId()));
+	const DHCPv6Message::Option *pServerId = advertise.FindOption(DHCPv6Message::MsgOption_SERVERID);
+	ASSERT_NE(nullptr, pServerId);
+	EXPECT_EQ(SERVER_DUID, std::vector<BYTE>(pServerId->pbData, pServerId->pbData + pServerId->length));
+	const DHCPv6Message::Option *pClientId = advertise.FindOption(DHCPv6Message::MsgOption_CLIENTID);
+	ASSERT_NE(nullptr, pClientId);
+	EXPECT_EQ(CLIENT_DUID, std::vector<BYTE>(pClientId->pbData, pClientId->pbData + pClientId->length));
+	const DHCPv6Message::Option *pDnsServers = advertise.FindOption(DHCPv6Message::MsgOption_DNS_SERVERS);
+	ASSERT_NE(nullptr, pDnsServers);
+	ASSERT_EQ(sizeof(IPv6Address), pDnsServers->length);
+	EXPECT_TRUE(std::equal(config.dhcpv6.dnsServers[0].begin(), config.dhcpv6.dnsServers[0].end(), pDnsServers->pbData));
+	const IPv6Address address = GetIAAddress(advertise);
+	EXPECT_TRUE(std::equal(address.begin(), address.begin() + 8, config.dhcpv6.prefix.begin()));
+	EXPECT_NE(IPv6Address{}, address);
+
+	// REQUEST commits the advertised address
+	request = MakeRequest6(DHCPv6Message::MsgType_REQUEST, true);
+	ASSERT_TRUE(server.ProcessRequest6(request.data(), static_cast<int>(request.size()), reply));
+	ASSERT_FALSE(reply.empty());
+	const DHCPv6Message requestReply(reply.data(), static_cast<int>(reply.size()));
+	EXPECT_EQ(DHCPv6Message::MsgType_REPLY, requestReply.GetMessageType());
+	EXPECT_EQ(address, GetIAAddress(requestReply));
+
+	// REQUEST for another server is discarded
+	request = MakeRequest6(DHCPv6Message::MsgType_REQUEST, false);
+	ASSERT_TRUE(server.ProcessRequest6(request.data(), static_cast<int>(request.size()), reply));
+	EXPECT_TRUE(reply.empty());
+
+	// RELEASE lists no IA_NA for a binding it released, only the overall status
+	request = MakeRequest6(DHCPv6Message::MsgType_RELEASE, true);
+	ASSERT_TRUE(server.ProcessRequest6(request.data(), static_cast<int>(request.size()), reply));
+	ASSERT_FALSE(reply.empty());
+	const DHCPv6Message releaseReply(reply.data(), static_cast<int>(reply.size()));
+	EXPECT_EQ(DHCPv6Message::MsgType_REPLY, releaseReply.GetMessageType());
+	EXPECT_EQ(nullptr, releaseReply.FindOption(DHCPv6Message::MsgOption_IA_NA));
+	const DHCPv6Message::Option *pStatus = releaseReply.FindOption(DHCPv6Message::MsgOption_STATUS_CODE);
+	ASSERT_NE(nullptr, pStatus);
+	EXPECT_EQ(std::vector<BYTE>({ 0, DHCPv6Message::Status_SUCCESS }), std::vector<BYTE>(pStatus->pbData, pStatus->pbData + pStatus->length));
+
+	// The binding is kept, so the client gets the same address back
+	request = MakeRequest6(DHCPv6Message::MsgType_SOLICIT, false);
+	ASSERT_TRUE(server.ProcessRequest6(request.data(), static_cast<int>(request.size()), reply));
+	ASSERT_FALSE(reply.empty());
+	EXPECT_EQ(address, GetIAAddress(DHCPv6Message(reply.data(), static_cast<int>(reply.size()))));
+
+	// A truncated message is dropped and counted
+	request.resize(6);
+	EXPECT_FALSE(server.ProcessRequest6(request.data(), static_cast<int>(request.size()), reply));
+	EXPECT_TRUE(reply.empty());
+	EXPECT_EQ(1u, server.GetPacketStatistics().dropped);
+}
+
+TEST_F(ServerTest, RecordsEveryPacketInTheTrace) {
+	ASSERT_TRUE(server.Init(config));
+	ASSERT_NE(0u, Bind());
+	EXPECT_EQ(nullptr, Process(MakeRequest(DHCPMessage::MsgType_DISCOVER, Address("10.2.0.1"))));
+	const BYTE truncated[16]{};
+	EXPECT_FALSE(server.ProcessRequest(truncated, sizeof(truncated)));
+
+	const PacketStatistics statistics = server.GetPacketStatistics();
+	EXPECT_EQ(4u, statistics.received);
+	EXPECT_EQ(2u, statistics.replied);
+	EXPECT_EQ(1u, statistics.ignored);
+	EXPECT_EQ(1u, statistics.dropped);
+
+	// Each packet is one event with its transaction id and result, and the dropped one is kept in full with its reason
+	const std::string trace = server.GetPacketTrace();
+	EXPECT_EQ(0u, trace.find("{\"traceEvents\":["));
+	EXPECT_NE(std::string::npos, trace.find("\"name\":\"DISCOVER\",\"cat\":\"packet\""));
+	EXPECT_NE(std::string::npos, trace.find("\"name\":\"REQUEST\",\"cat\":\"packet\""));
+	EXPECT_NE(std::string::npos, trace.find("\"xid\":\"0x78563412\",\"result\":\"replied\""));
+	EXPECT_NE(std::string::npos, trace.find("\"result\":\"ignored\""));
+	EXPECT_NE(std::string::npos, trace.find("\"pid\":2,\"tid\":0,\"args\":{\"xid\":\"0x00000000\",\"result\":\"dropped\",\"data\":\"00000000"));
+	EXPECT_NE(std::string::npos, trace.find("\"name\":\"allocate\",\"cat\":\"stage\""));
+	EXPECT_EQ(std::string::npos, trace.find("\"result\":\"replied\",\"data\""));
+}